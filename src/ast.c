@@ -302,6 +302,22 @@ AST *ast_continue(void) {
     return n;
 }
 
+AST *ast_switch(AST *expr, AST *cases) {
+    AST *n = ast_alloc();
+    n->kind = AST_SWITCH;
+    n->switch_stmt.expr = expr;
+    n->switch_stmt.cases = cases;
+    return n;
+}
+
+AST *ast_case(AST *value, AST *body) {
+    AST *n = ast_alloc();
+    n->kind = AST_CASE;
+    n->case_stmt.value = value;
+    n->case_stmt.body = body;
+    return n;
+}
+
 
 static void ast_print_indent(int indent) {
     for (int i = 0; i < indent; ++i) putchar(' ');
@@ -636,11 +652,25 @@ static void ast_print_helper(AST *node, int indent) {
             break;
 
         case AST_SWITCH:
-            printf("SWITCH (not fully implemented)\n");
+            printf("SWITCH\n");
+            ast_print_indent(indent + 2);
+            printf("expression:\n");
+            ast_print_helper(node->switch_stmt.expr, indent + 4);
+            for (AST *c = node->switch_stmt.cases; c; c = c->next) {
+                ast_print_helper(c, indent + 2);
+            }
             break;
 
         case AST_CASE:
-            printf("CASE (not fully implemented)\n");
+            if (node->case_stmt.value) {
+                printf("CASE\n");
+                ast_print_helper(node->case_stmt.value, indent + 2);
+            } else {
+                printf("DEFAULT\n");
+            }
+            ast_print_indent(indent + 2);
+            printf("body:\n");
+            ast_print_helper(node->case_stmt.body, indent + 4);
             break;
 
         default:
@@ -822,9 +852,21 @@ void ast_free(AST *node) {
             free(node);
             break;
 
-        case AST_SWITCH:
+        case AST_SWITCH: {
+            ast_free(node->switch_stmt.expr);
+            AST *c = node->switch_stmt.cases;
+            while (c) {
+                AST *next = c->next;
+                ast_free(c);
+                c = next;
+            }
+            free(node);
+            break;
+        }
+
         case AST_CASE:
-            // Not fully implemented - add proper cleanup if needed
+            if (node->case_stmt.value) ast_free(node->case_stmt.value);
+            if (node->case_stmt.body) ast_free(node->case_stmt.body);
             free(node);
             break;
 
@@ -214,6 +214,17 @@ typedef struct AST {
         } for_stmt;
 
         struct { struct AST *expr; } ret;
+
+        struct {
+            struct AST *expr;
+            struct AST *cases;  // linked list of AST_CASE, in source order
+        } switch_stmt;
+
+        /* case: value is NULL for default; body holds the statements up to the next label */
+        struct {
+            struct AST *value;
+            struct AST *body;
+        } case_stmt;
     };
 } AST;
 
@@ -250,6 +261,8 @@ AST *ast_for(AST *init, AST *cond, AST *post, AST *body);
 AST *ast_return(AST *expr);
 AST *ast_break(void);
 AST *ast_continue(void);
+AST *ast_switch(AST *expr, AST *cases);
+AST *ast_case(AST *value, AST *body); /* value is NULL for default */
 
 AST *ast_list_prepend(AST *node, AST *head); /* prepends node to linked list head */
 AST *ast_list_append(AST *node, AST *head);
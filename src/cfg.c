@@ -0,0 +1,651 @@
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Element count for an allocation: a non-negative int as a size_t, and at
+// least 1 so that an empty array still gets a pointer of its own
+static size_t array_len(int count) {
+    return count > 0 ? (size_t)count : 1;
+}
+
+// ---- Bitsets ----
+
+void bitset_init(Bitset *b, int nbits) {
+    b->nbits = nbits;
+    b->nwords = (nbits + 63) / 64;
+    b->words = calloc(array_len(b->nwords), sizeof(uint64_t));
+}
+
+void bitset_free(Bitset *b) {
+    free(b->words);
+    b->words = NULL;
+    b->nbits = b->nwords = 0;
+}
+
+void bitset_clear_all(Bitset *b) {
+    memset(b->words, 0, b->nwords * sizeof(uint64_t));
+}
+
+void bitset_set_all(Bitset *b) {
+    memset(b->words, 0xff, b->nwords * sizeof(uint64_t));
+    // Keep the bits past nbits clear so equality and counting stay exact
+    if (b->nbits % 64) {
+        b->words[b->nwords - 1] = (UINT64_C(1) << (b->nbits % 64)) - 1;
+    }
+}
+
+void bitset_set(Bitset *b, int i) {
+    b->words[i / 64] |= UINT64_C(1) << (i % 64);
+}
+
+void bitset_clear(Bitset *b, int i) {
+    b->words[i / 64] &= ~(UINT64_C(1) << (i % 64));
+}
+
+bool bitset_test(const Bitset *b, int i) {
+    return (b->words[i / 64] >> (i % 64)) & 1;
+}
+
+int bitset_count(const Bitset *b) {
+    int n = 0;
+    for (int i = 0; i < b->nwords; i++) {
+        n += __builtin_popcountll(b->words[i]);
+    }
+    return n;
+}
+
+void bitset_copy(Bitset *dst, const Bitset *src) {
+    memcpy(dst->words, src->words, src->nwords * sizeof(uint64_t));
+}
+
+bool bitset_equal(const Bitset *a, const Bitset *b) {
+    return memcmp(a->words, b->words, a->nwords * sizeof(uint64_t)) == 0;
+}
+
+void bitset_union(Bitset *dst, const Bitset *src) {
+    for (int i = 0; i < dst->nwords; i++) dst->words[i] |= src->words[i];
+}
+
+void bitset_intersect(Bitset *dst, const Bitset *src) {
+    for (int i = 0; i < dst->nwords; i++) dst->words[i] &= src->words[i];
+}
+
+void bitset_subtract(Bitset *dst, const Bitset *src) {
+    for (int i = 0; i < dst->nwords; i++) dst->words[i] &= ~src->words[i];
+}
+
+// ---- Graph construction ----
+
+// Instructions after which control does not simply fall through
+static bool ends_block(IRKind k) {
+    return ir_is_jump(k) || k == IR_SWITCH || k == IR_RETURN || k == IR_RETURN_VOID;
+}
+
+static void add_edge(CFG *cfg, int from, int to) {
+    BasicBlock *a = &cfg->blocks[from];
+    BasicBlock *b = &cfg->blocks[to];
+
+    for (int i = 0; i < a->nsuccs; i++) {
+        if (a->succs[i] == to) return;
+    }
+
+    a->succs = realloc(a->succs, array_len(a->nsuccs + 1) * sizeof(int));
+    a->succs[a->nsuccs++] = to;
+    b->preds = realloc(b->preds, array_len(b->npreds + 1) * sizeof(int));
+    b->preds[b->npreds++] = from;
+}
+
+static void split_blocks(CFG *cfg) {
+    IRList *ir = cfg->ir;
+    int n = ir->count;
+    bool *leader = calloc(array_len(n + 1), sizeof(bool));
+
+    leader[0] = true;
+    for (int i = 0; i < n; i++) {
+        if (ir->code[i].kind == IR_LABEL) leader[i] = true;
+        if (ends_block(ir->code[i].kind)) leader[i + 1] = true;
+    }
+    leader[n] = false;
+
+    // An empty function still gets an (empty) entry block
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (leader[i]) count++;
+    }
+    if (count == 0) count = 1;
+
+    cfg->count = count;
+    cfg->blocks = calloc(array_len(count), sizeof(BasicBlock));
+    cfg->block_of = malloc(array_len(n) * sizeof(int));
+
+    int b = -1;
+    for (int i = 0; i < n; i++) {
+        if (leader[i]) {
+            b++;
+            cfg->blocks[b].start = i;
+        }
+        cfg->blocks[b].end = i + 1;
+        cfg->block_of[i] = b;
+    }
+
+    free(leader);
+}
+
+// True if control can leave block b by running past its last instruction:
+// the block is empty or does not end in a jump, switch or return
+bool cfg_falls_through(CFG *cfg, int b) {
+    BasicBlock *bb = &cfg->blocks[b];
+    if (bb->end == bb->start) return true;
+
+    IRKind k = cfg->ir->code[bb->end - 1].kind;
+    return k != IR_JUMP && k != IR_SWITCH && k != IR_RETURN && k != IR_RETURN_VOID;
+}
+
+// True if control can run off the end of the code
+bool cfg_falls_off_end(CFG *cfg) {
+    int last = cfg->count - 1;
+    return cfg->blocks[last].rpo_index >= 0 && cfg_falls_through(cfg, last);
+}
+
+bool cfg_loop_has_preheader_slot(CFG *cfg, Loop *loop) {
+    int h = loop->header;
+    return h == 0 || !bitset_test(&loop->body, h - 1) || !cfg_falls_through(cfg, h - 1);
+}
+
+void cfg_retarget_loop_entries(CFG *cfg, Loop *loop, int label) {
+    IRList *ir = cfg->ir;
+
+    for (int b = 0; b < cfg->count; b++) {
+        if (bitset_test(&loop->body, b)) continue;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            IRInstruction *p = &ir->code[i];
+            for (int k = 0; k < ir_jump_count(ir, p); k++) {
+                int *target_label = ir_jump_label(ir, p, k);
+                int target = ir_label_target(ir, *target_label);
+                if (target >= 0 && cfg->block_of[target] == loop->header) *target_label = label;
+            }
+        }
+    }
+}
+
+static void link_blocks(CFG *cfg) {
+    IRList *ir = cfg->ir;
+
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+
+        if (bb->end > bb->start) {
+            IRInstruction *last = &ir->code[bb->end - 1];
+            int target = -1;
+
+            if (ir_is_jump(last->kind)) {
+                target = ir_label_target(ir, last->i);
+            } else if (last->kind == IR_SWITCH) {
+                for (int k = 0; k < ir_jump_count(ir, last); k++) {
+                    int t = ir_label_target(ir, *ir_jump_label(ir, last, k));
+                    if (t >= 0) add_edge(cfg, b, cfg->block_of[t]);
+                }
+            }
+
+            if (target >= 0) {
+                add_edge(cfg, b, cfg->block_of[target]);
+            }
+        }
+
+        if (cfg_falls_through(cfg, b) && b + 1 < cfg->count) {
+            add_edge(cfg, b, b + 1);
+        }
+    }
+}
+
+static void compute_rpo(CFG *cfg) {
+    int *post = malloc(array_len(cfg->count) * sizeof(int));
+    int *stack = malloc(array_len(cfg->count) * sizeof(int));
+    int *next = calloc(array_len(cfg->count), sizeof(int));
+    bool *seen = calloc(array_len(cfg->count), sizeof(bool));
+    int npost = 0, sp = 0;
+
+    stack[sp++] = 0;
+    seen[0] = true;
+    while (sp > 0) {
+        int b = stack[sp - 1];
+        BasicBlock *bb = &cfg->blocks[b];
+
+        if (next[b] < bb->nsuccs) {
+            int s = bb->succs[next[b]++];
+            if (!seen[s]) {
+                seen[s] = true;
+                stack[sp++] = s;
+            }
+        } else {
+            post[npost++] = b;
+            sp--;
+        }
+    }
+
+    cfg->rpo = malloc(array_len(cfg->count) * sizeof(int));
+    cfg->rpo_count = npost;
+    for (int b = 0; b < cfg->count; b++) {
+        cfg->blocks[b].rpo_index = -1;
+    }
+    for (int i = 0; i < npost; i++) {
+        cfg->rpo[i] = post[npost - 1 - i];
+        cfg->blocks[cfg->rpo[i]].rpo_index = i;
+    }
+
+    free(post);
+    free(stack);
+    free(next);
+    free(seen);
+}
+
+static int intersect_doms(CFG *cfg, int a, int b) {
+    while (a != b) {
+        while (cfg->blocks[a].rpo_index > cfg->blocks[b].rpo_index) a = cfg->blocks[a].idom;
+        while (cfg->blocks[b].rpo_index > cfg->blocks[a].rpo_index) b = cfg->blocks[b].idom;
+    }
+    return a;
+}
+
+// Iterative dominator computation (Cooper, Harvey and Kennedy)
+static void compute_dominators(CFG *cfg) {
+    for (int b = 0; b < cfg->count; b++) {
+        cfg->blocks[b].idom = -1;
+    }
+    cfg->blocks[0].idom = 0;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (int i = 1; i < cfg->rpo_count; i++) {
+            BasicBlock *bb = &cfg->blocks[cfg->rpo[i]];
+            int new_idom = -1;
+
+            for (int p = 0; p < bb->npreds; p++) {
+                int pred = bb->preds[p];
+                if (cfg->blocks[pred].idom < 0) continue;
+                new_idom = new_idom < 0 ? pred : intersect_doms(cfg, pred, new_idom);
+            }
+
+            if (new_idom != bb->idom) {
+                bb->idom = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    cfg->blocks[0].idom = -1;
+}
+
+bool cfg_dominates(CFG *cfg, int a, int b) {
+    if (cfg->blocks[b].rpo_index < 0) return false;
+
+    while (b >= 0) {
+        if (b == a) return true;
+        b = cfg->blocks[b].idom;
+    }
+    return false;
+}
+
+static int compare_loop_size(const void *x, const void *y) {
+    const Loop *a = x, *b = y;
+    int na = bitset_count(&a->body), nb = bitset_count(&b->body);
+    if (na != nb) return nb - na;
+    return a->header - b->header;
+}
+
+// Natural loops: every edge b -> h where h dominates b is a back edge, and
+// the loop body is h plus everything that reaches b without passing h.
+// Back edges sharing a header form one loop.
+static void find_loops(CFG *cfg) {
+    int *work = malloc(array_len(cfg->count) * sizeof(int));
+
+    for (int i = 0; i < cfg->rpo_count; i++) {
+        int b = cfg->rpo[i];
+        BasicBlock *bb = &cfg->blocks[b];
+
+        for (int s = 0; s < bb->nsuccs; s++) {
+            int h = bb->succs[s];
+            if (!cfg_dominates(cfg, h, b)) continue;
+
+            Loop *loop = NULL;
+            for (int l = 0; l < cfg->loop_count; l++) {
+                if (cfg->loops[l].header == h) loop = &cfg->loops[l];
+            }
+            if (!loop) {
+                cfg->loops = realloc(cfg->loops, array_len(cfg->loop_count + 1) * sizeof(Loop));
+                loop = &cfg->loops[cfg->loop_count++];
+                loop->header = h;
+                bitset_init(&loop->body, cfg->count);
+                bitset_set(&loop->body, h);
+            }
+
+            int nwork = 0;
+            if (!bitset_test(&loop->body, b)) {
+                bitset_set(&loop->body, b);
+                work[nwork++] = b;
+            }
+            while (nwork > 0) {
+                BasicBlock *wb = &cfg->blocks[work[--nwork]];
+                for (int p = 0; p < wb->npreds; p++) {
+                    int pred = wb->preds[p];
+                    if (cfg->blocks[pred].rpo_index < 0) continue;
+                    if (!bitset_test(&loop->body, pred)) {
+                        bitset_set(&loop->body, pred);
+                        work[nwork++] = pred;
+                    }
+                }
+            }
+        }
+    }
+    free(work);
+
+    // Larger loops first, so every loop comes after the loops enclosing it
+    if (cfg->loop_count > 1) qsort(cfg->loops, cfg->loop_count, sizeof(Loop), compare_loop_size);
+
+    for (int l = 0; l < cfg->loop_count; l++) {
+        Loop *loop = &cfg->loops[l];
+        loop->parent = -1;
+        loop->depth = 1;
+        for (int o = l - 1; o >= 0; o--) {
+            if (bitset_test(&cfg->loops[o].body, loop->header)) {
+                loop->parent = o;
+                loop->depth = cfg->loops[o].depth + 1;
+                break;
+            }
+        }
+    }
+
+    for (int b = 0; b < cfg->count; b++) {
+        cfg->blocks[b].loop = -1;
+        cfg->blocks[b].loop_depth = 0;
+        for (int l = 0; l < cfg->loop_count; l++) {
+            if (bitset_test(&cfg->loops[l].body, b)) {
+                cfg->blocks[b].loop = l;
+                cfg->blocks[b].loop_depth++;
+            }
+        }
+    }
+}
+
+void cfg_build(CFG *cfg, IRList *ir) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->ir = ir;
+
+    ir_resolve_labels(ir);
+    split_blocks(cfg);
+    link_blocks(cfg);
+    compute_rpo(cfg);
+    compute_dominators(cfg);
+    find_loops(cfg);
+}
+
+void cfg_free(CFG *cfg) {
+    for (int b = 0; b < cfg->count; b++) {
+        free(cfg->blocks[b].succs);
+        free(cfg->blocks[b].preds);
+    }
+    for (int l = 0; l < cfg->loop_count; l++) {
+        bitset_free(&cfg->loops[l].body);
+    }
+    free(cfg->blocks);
+    free(cfg->block_of);
+    free(cfg->rpo);
+    free(cfg->loops);
+    memset(cfg, 0, sizeof(*cfg));
+}
+
+// ---- Operand stack depth ----
+
+void cfg_stack_depths(CFG *cfg, StackEffect effect, StackDepths *d) {
+    IRList *ir = cfg->ir;
+    d->depth = malloc(array_len(ir->count) * sizeof(int));
+    for (int i = 0; i < ir->count; i++) d->depth[i] = -1;
+    d->max = 0;
+    d->underflow = -1;
+    d->edge_from = d->edge_to = -1;
+    d->edge_depth = d->other_depth = 0;
+
+    int *depth_in = malloc(array_len(cfg->count) * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) depth_in[b] = -1;
+    depth_in[0] = 0;
+
+    for (int r = 0; r < cfg->rpo_count; r++) {
+        int b = cfg->rpo[r];
+        BasicBlock *bb = &cfg->blocks[b];
+        int depth = depth_in[b];
+        if (depth < 0) continue;
+
+        for (int i = bb->start; i < bb->end; i++) {
+            int pops, pushes;
+            effect(&ir->code[i], &pops, &pushes);
+            if (depth < pops) {
+                if (d->underflow < 0) d->underflow = i;
+                depth = pops;
+            }
+            d->depth[i] = depth;
+            depth += pushes - pops;
+            if (depth > d->max) d->max = depth;
+        }
+
+        for (int s = 0; s < bb->nsuccs; s++) {
+            int succ = bb->succs[s];
+            if (depth_in[succ] < 0) {
+                depth_in[succ] = depth;
+            } else if (depth_in[succ] != depth && d->edge_from < 0) {
+                d->edge_from = b;
+                d->edge_to = succ;
+                d->edge_depth = depth;
+                d->other_depth = depth_in[succ];
+            }
+        }
+    }
+
+    free(depth_in);
+}
+
+void stack_depths_free(StackDepths *d) {
+    free(d->depth);
+    d->depth = NULL;
+}
+
+// ---- Graphviz output ----
+
+static void dot_escaped(FILE *out, const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\' || *s == '{' || *s == '}' || *s == '<' || *s == '>' || *s == '|') {
+            fputc('\\', out);
+        }
+        fputc(*s, out);
+    }
+}
+
+void cfg_dump_dot(FILE *out, CFG *cfg, const char *name) {
+    fprintf(out, "  subgraph \"cluster_%s\" {\n", name);
+    fprintf(out, "    label=\"%s\";\n", name);
+    fprintf(out, "    node [shape=box, fontname=\"monospace\"];\n");
+
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+
+        fprintf(out, "    \"%s.B%d\" [label=\"B%d", name, b, b);
+        if (bb->rpo_index < 0) {
+            fprintf(out, " (unreachable)");
+        } else {
+            if (bb->idom >= 0) fprintf(out, " idom=B%d", bb->idom);
+            if (bb->loop_depth > 0) fprintf(out, " loop depth %d", bb->loop_depth);
+        }
+        fprintf(out, "\\l");
+
+        for (int i = bb->start; i < bb->end; i++) {
+            char *text = NULL;
+            size_t len = 0;
+            FILE *buf = open_memstream(&text, &len);
+            ir_print_instr(&cfg->ir->code[i], buf);
+            fclose(buf);
+
+            fprintf(out, "%d: ", i);
+            dot_escaped(out, text);
+            fprintf(out, "\\l");
+            free(text);
+        }
+        fprintf(out, "\"%s];\n", bb->rpo_index < 0 ? ", style=dashed" : "");
+    }
+
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+        IRKind last = bb->end > bb->start ? cfg->ir->code[bb->end - 1].kind : IR_NOP;
+
+        for (int s = 0; s < bb->nsuccs; s++) {
+            int to = bb->succs[s];
+            fprintf(out, "    \"%s.B%d\" -> \"%s.B%d\"", name, b, name, to);
+
+            if (ir_is_cond_branch(last)) {
+                bool taken = ir_label_target(cfg->ir, cfg->ir->code[bb->end - 1].i) == cfg->blocks[to].start;
+                if (last == IR_JUMP_IF_ZERO) {
+                    fprintf(out, " [label=\"%s\"", taken ? "zero" : "nonzero");
+                } else {
+                    fprintf(out, " [label=\"%s\"", taken ? "taken" : "not taken");
+                }
+            } else {
+                fprintf(out, " [");
+            }
+            if (cfg_dominates(cfg, to, b)) {
+                fprintf(out, "%sstyle=bold", ir_is_cond_branch(last) ? ", " : "");
+            }
+            fprintf(out, "];\n");
+        }
+    }
+
+    fprintf(out, "  }\n");
+}
+
+// ---- Dataflow ----
+
+static void meet_into(DataflowMeet meet, Bitset *dst, const Bitset *src) {
+    if (meet == DF_UNION) {
+        bitset_union(dst, src);
+    } else {
+        bitset_intersect(dst, src);
+    }
+}
+
+static void set_top(DataflowMeet meet, Bitset *b) {
+    if (meet == DF_UNION) {
+        bitset_clear_all(b);
+    } else {
+        bitset_set_all(b);
+    }
+}
+
+// Round-robin worklist solver. Blocks are queued in reverse post-order
+// (forward) or post-order (backward) and requeued only when an input changes.
+void dataflow_solve(CFG *cfg, DataflowProblem *p, DataflowResult *r) {
+    int n = cfg->count;
+    bool forward = p->direction == DF_FORWARD;
+
+    r->count = n;
+    r->in = malloc(array_len(n) * sizeof(Bitset));
+    r->out = malloc(array_len(n) * sizeof(Bitset));
+    for (int b = 0; b < n; b++) {
+        bitset_init(&r->in[b], p->nbits);
+        bitset_init(&r->out[b], p->nbits);
+        set_top(p->meet, &r->in[b]);
+        set_top(p->meet, &r->out[b]);
+    }
+
+    Bitset tmp;
+    bitset_init(&tmp, p->nbits);
+
+    // Circular queue; each block is in it at most once
+    int *queue = malloc(array_len(n + 1) * sizeof(int));
+    bool *queued = calloc(array_len(n), sizeof(bool));
+    int head = 0, tail = 0;
+
+    for (int i = 0; i < cfg->rpo_count; i++) {
+        int b = forward ? cfg->rpo[i] : cfg->rpo[cfg->rpo_count - 1 - i];
+        queue[tail++] = b;
+        queued[b] = true;
+    }
+
+    while (head != tail) {
+        int b = queue[head];
+        head = (head + 1) % (n + 1);
+        queued[b] = false;
+
+        BasicBlock *bb = &cfg->blocks[b];
+        // Value flowing into the block and value it produces, in the
+        // direction of the problem
+        Bitset *before = forward ? &r->in[b] : &r->out[b];
+        Bitset *after = forward ? &r->out[b] : &r->in[b];
+        int nedges = forward ? bb->npreds : bb->nsuccs;
+        int *edges = forward ? bb->preds : bb->succs;
+        bool boundary = forward ? b == 0 : bb->nsuccs == 0;
+
+        if (boundary) {
+            if (p->boundary) {
+                bitset_copy(before, p->boundary);
+            } else {
+                bitset_clear_all(before);
+            }
+        } else {
+            set_top(p->meet, before);
+        }
+        for (int e = 0; e < nedges; e++) {
+            int other = edges[e];
+            if (cfg->blocks[other].rpo_index < 0) continue;
+            meet_into(p->meet, before, forward ? &r->out[other] : &r->in[other]);
+        }
+
+        p->transfer(cfg, b, before, &tmp, p->ctx);
+        if (bitset_equal(&tmp, after)) continue;
+        bitset_copy(after, &tmp);
+
+        int nnext = forward ? bb->nsuccs : bb->npreds;
+        int *next = forward ? bb->succs : bb->preds;
+        for (int e = 0; e < nnext; e++) {
+            int s = next[e];
+            if (queued[s] || cfg->blocks[s].rpo_index < 0) continue;
+            queue[tail] = s;
+            tail = (tail + 1) % (n + 1);
+            queued[s] = true;
+        }
+    }
+
+    bitset_free(&tmp);
+    free(queue);
+    free(queued);
+}
+
+void dataflow_free(DataflowResult *r) {
+    for (int b = 0; b < r->count; b++) {
+        bitset_free(&r->in[b]);
+        bitset_free(&r->out[b]);
+    }
+    free(r->in);
+    free(r->out);
+    r->in = r->out = NULL;
+    r->count = 0;
+}
+
+// ---- Liveness ----
+
+static void liveness_transfer(CFG *cfg, int block, const Bitset *in, Bitset *out, void *ctx) {
+    BasicBlock *bb = &cfg->blocks[block];
+
+    bitset_copy(out, in);
+    for (int i = bb->end - 1; i >= bb->start; i--) {
+        IRInstruction *p = &cfg->ir->code[i];
+        if (p->kind == IR_STORE_LOCAL) {
+            bitset_clear(out, p->i);
+        } else if (p->kind == IR_LOAD_LOCAL || p->kind == IR_INC) {
+            bitset_set(out, p->i);
+        }
+    }
+}
+
+void cfg_liveness(CFG *cfg, int nlocals, DataflowResult *r) {
+    DataflowProblem p = { DF_BACKWARD, DF_UNION, nlocals, NULL, liveness_transfer, NULL };
+    dataflow_solve(cfg, &p, r);
+}
@@ -0,0 +1,133 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+
+// Fixed-size bit vector used as the lattice for dataflow problems
+typedef struct {
+    int nbits;
+    int nwords;
+    uint64_t *words;
+} Bitset;
+
+void bitset_init(Bitset *b, int nbits);
+void bitset_free(Bitset *b);
+void bitset_clear_all(Bitset *b);
+void bitset_set_all(Bitset *b);
+void bitset_set(Bitset *b, int i);
+void bitset_clear(Bitset *b, int i);
+bool bitset_test(const Bitset *b, int i);
+int bitset_count(const Bitset *b);
+void bitset_copy(Bitset *dst, const Bitset *src);
+bool bitset_equal(const Bitset *a, const Bitset *b);
+void bitset_union(Bitset *dst, const Bitset *src);
+void bitset_intersect(Bitset *dst, const Bitset *src);
+void bitset_subtract(Bitset *dst, const Bitset *src);
+
+// A maximal straight-line run of IR instructions [start, end)
+typedef struct {
+    int start;
+    int end;
+    int *succs;
+    int nsuccs;
+    int *preds;
+    int npreds;
+    int idom;           // immediate dominator, -1 for the entry and unreachable blocks
+    int rpo_index;      // position in reverse post-order, -1 if unreachable
+    int loop;           // innermost loop containing this block, -1 if none
+    int loop_depth;     // number of loops containing this block
+} BasicBlock;
+
+// A natural loop, found from the back edges into its header
+typedef struct {
+    int header;
+    int parent;         // enclosing loop, -1 for outermost loops
+    int depth;          // 1 for outermost loops
+    Bitset body;        // blocks in the loop, including the header
+} Loop;
+
+typedef struct {
+    IRList *ir;
+    BasicBlock *blocks;     // blocks[0] is the entry
+    int count;
+    int *block_of;          // IR instruction index -> block
+    int *rpo;               // reachable blocks in reverse post-order
+    int rpo_count;
+    Loop *loops;            // outer loops before the loops they contain
+    int loop_count;
+} CFG;
+
+// Split ir into basic blocks and compute edges, dominators and loops.
+// Rebuilds the IR's label table.
+void cfg_build(CFG *cfg, IRList *ir);
+void cfg_free(CFG *cfg);
+
+bool cfg_dominates(CFG *cfg, int a, int b);
+
+bool cfg_falls_through(CFG *cfg, int b);
+bool cfg_falls_off_end(CFG *cfg);
+
+// True if a preheader can go just before the loop's header: the block
+// before the header must not fall into it from inside the loop
+bool cfg_loop_has_preheader_slot(CFG *cfg, Loop *loop);
+
+// Redirect jumps into the loop's header from outside the loop to label
+void cfg_retarget_loop_entries(CFG *cfg, Loop *loop, int label);
+
+// Operand stack depth along the CFG, in reverse post-order, with effect
+// giving the values each instruction pops and pushes
+typedef void (*StackEffect)(IRInstruction *p, int *pops, int *pushes);
+
+typedef struct {
+    int *depth;             // depth before each instruction, -1 where unreachable
+    int max;                // highest depth after any instruction
+    int underflow;          // first instruction popping more than the stack holds, -1 if none
+    int edge_from;          // first edge reached with a depth other than an
+    int edge_to;            // earlier path into the same block, -1 if none
+    int edge_depth;         // depth along that edge
+    int other_depth;        // depth the block was first reached with
+} StackDepths;
+
+void cfg_stack_depths(CFG *cfg, StackEffect effect, StackDepths *d);
+void stack_depths_free(StackDepths *d);
+
+// Write the graph as a Graphviz cluster named after the function
+void cfg_dump_dot(FILE *out, CFG *cfg, const char *name);
+
+// A dataflow problem over bitsets. transfer computes out from in for one
+// block (for backward problems in is the value at the block's end and out
+// the value at its start). The solver starts interior blocks at the top of
+// the lattice (empty for union, full for intersection) and boundary blocks
+// (entry for forward, exits for backward) at boundary, or empty if NULL.
+typedef enum { DF_FORWARD, DF_BACKWARD } DataflowDirection;
+typedef enum { DF_UNION, DF_INTERSECT } DataflowMeet;
+
+typedef struct {
+    DataflowDirection direction;
+    DataflowMeet meet;
+    int nbits;
+    const Bitset *boundary;
+    void (*transfer)(CFG *cfg, int block, const Bitset *in, Bitset *out, void *ctx);
+    void *ctx;
+} DataflowProblem;
+
+// Solution per block, in program order: in[b] holds at the start of the
+// block and out[b] at its end, whatever the direction
+typedef struct {
+    Bitset *in;
+    Bitset *out;
+    int count;
+} DataflowResult;
+
+void dataflow_solve(CFG *cfg, DataflowProblem *p, DataflowResult *r);
+void dataflow_free(DataflowResult *r);
+
+// Local slots live at the start (in) and end (out) of each block: read
+// (or incremented) later on some path before being written
+void cfg_liveness(CFG *cfg, int nlocals, DataflowResult *r);
+
+#endif
@@ -0,0 +1,198 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Store-to-load forwarding, copy propagation and dead store elimination
+// for local variable slots.
+
+// A copy between slots: LOAD_LOCAL src; STORE_LOCAL dst
+typedef struct {
+    int dst;
+    int src;
+} Copy;
+
+typedef struct {
+    Copy *copies;
+    int count;
+    int *copy_at;       // instruction index -> copy made by the store there, or -1
+} CopyTable;
+
+static void find_copies(IRList *ir, CopyTable *t) {
+    t->copies = NULL;
+    t->count = 0;
+    t->copy_at = malloc((ir->count ? ir->count : 1) * sizeof(int));
+
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *store = &ir->code[i];
+        IRInstruction *load = i > 0 ? &ir->code[i - 1] : NULL;
+
+        t->copy_at[i] = -1;
+        if (store->kind == IR_STORE_LOCAL && load && load->kind == IR_LOAD_LOCAL &&
+            load->i != store->i && load->type == store->type) {
+            t->copies = realloc(t->copies, (t->count + 1) * sizeof(Copy));
+            t->copies[t->count].dst = store->i;
+            t->copies[t->count].src = load->i;
+            t->copy_at[i] = t->count++;
+        }
+    }
+}
+
+// A store to slot kills every copy that reads or writes it, then the store
+// may itself make a copy
+static void store_local(CopyTable *t, Bitset *avail, int slot, int copy) {
+    for (int c = 0; c < t->count; c++) {
+        if (t->copies[c].dst == slot || t->copies[c].src == slot) {
+            bitset_clear(avail, c);
+        }
+    }
+    if (copy >= 0) bitset_set(avail, copy);
+}
+
+static void copies_transfer(CFG *cfg, int block, const Bitset *in, Bitset *out, void *ctx) {
+    CopyTable *t = ctx;
+    BasicBlock *bb = &cfg->blocks[block];
+
+    bitset_copy(out, in);
+    for (int i = bb->start; i < bb->end; i++) {
+        IRKind k = cfg->ir->code[i].kind;
+        if (k == IR_STORE_LOCAL || k == IR_INC) {
+            store_local(t, out, cfg->ir->code[i].i, t->copy_at[i]);
+        }
+    }
+}
+
+// Read the original slot instead of a copy of it, wherever the copy is
+// still valid on every path
+static int propagate_copies(IRList *ir) {
+    CFG cfg;
+    CopyTable t;
+    int changed = 0;
+
+    find_copies(ir, &t);
+    if (t.count == 0) {
+        free(t.copy_at);
+        return 0;
+    }
+
+    cfg_build(&cfg, ir);
+    DataflowProblem p = { DF_FORWARD, DF_INTERSECT, t.count, NULL, copies_transfer, &t };
+    DataflowResult r;
+    dataflow_solve(&cfg, &p, &r);
+
+    Bitset avail;
+    bitset_init(&avail, t.count);
+    for (int b = 0; b < cfg.count; b++) {
+        BasicBlock *bb = &cfg.blocks[b];
+        if (bb->rpo_index < 0) continue;
+
+        bitset_copy(&avail, &r.in[b]);
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInstruction *q = &ir->code[i];
+            if (q->kind == IR_STORE_LOCAL || q->kind == IR_INC) {
+                store_local(&t, &avail, q->i, t.copy_at[i]);
+            } else if (q->kind == IR_LOAD_LOCAL) {
+                for (int c = 0; c < t.count; c++) {
+                    if (t.copies[c].dst == q->i && bitset_test(&avail, c)) {
+                        q->i = t.copies[c].src;
+                        changed++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    bitset_free(&avail);
+    dataflow_free(&r);
+    cfg_free(&cfg);
+    free(t.copies);
+    free(t.copy_at);
+    return changed;
+}
+
+// STORE n; LOAD n  ->  DUP; STORE n, and LOAD n; STORE n disappears
+static int forward_stores(IRList *ir) {
+    int changed = 0;
+
+    for (int i = 0; i + 1 < ir->count; i++) {
+        IRInstruction *a = &ir->code[i], *b = &ir->code[i + 1];
+        if (a->i != b->i || a->type != b->type) continue;
+
+        if (a->kind == IR_STORE_LOCAL && b->kind == IR_LOAD_LOCAL) {
+            *b = *a;
+            a->kind = IR_DUP;
+            a->type = IRT_NONE;
+            a->i = 0;
+            changed++;
+        } else if (a->kind == IR_LOAD_LOCAL && b->kind == IR_STORE_LOCAL) {
+            a->kind = IR_NOP;
+            b->kind = IR_NOP;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+// Stores to slots that are not read again become pops, and increments of
+// them disappear
+static int remove_dead_stores(IRList *ir) {
+    int nlocals = ir_local_count(ir);
+    int changed = 0;
+    if (nlocals == 0) return 0;
+
+    CFG cfg;
+    DataflowResult r;
+    cfg_build(&cfg, ir);
+    cfg_liveness(&cfg, nlocals, &r);
+
+    Bitset live;
+    bitset_init(&live, nlocals);
+    for (int b = 0; b < cfg.count; b++) {
+        BasicBlock *bb = &cfg.blocks[b];
+        if (bb->rpo_index < 0) continue;
+
+        bitset_copy(&live, &r.out[b]);
+        for (int i = bb->end - 1; i >= bb->start; i--) {
+            IRInstruction *q = &ir->code[i];
+            if (q->kind == IR_STORE_LOCAL) {
+                if (!bitset_test(&live, q->i)) {
+                    q->kind = IR_POP;
+                    q->type = IRT_NONE;
+                    q->i = 0;
+                    changed++;
+                } else {
+                    bitset_clear(&live, q->i);
+                }
+            } else if (q->kind == IR_INC) {
+                if (!bitset_test(&live, q->i)) {
+                    q->kind = IR_NOP;
+                    changed++;
+                }
+            } else if (q->kind == IR_LOAD_LOCAL) {
+                bitset_set(&live, q->i);
+            }
+        }
+    }
+
+    bitset_free(&live);
+    dataflow_free(&r);
+    cfg_free(&cfg);
+    return changed;
+}
+
+int pass_copy_prop(IRList *ir, AST *func) {
+    int changed = 0;
+
+    // Each round can expose copies of copies
+    for (int round = 0; round < 4; round++) {
+        int n = propagate_copies(ir);
+        changed += n;
+        if (n == 0) break;
+    }
+
+    changed += forward_stores(ir);
+    ir_remove_nops(ir);
+    changed += remove_dead_stores(ir);
+    return changed;
+}
@@ -4,4 +4,18 @@
 extern int mode;
 extern struct AST *root_ast;
 
+// Command line options (see handleInputs)
+extern char *input_file;
+extern int num_jobs;        // -j N: worker threads for code generation
+extern int opt_level;       // -O0/-O1/-O2
+extern char *opt_passes;    // --passes=a,b,c: explicit pass pipeline, overrides -O
+extern int pass_stats;      // --pass-stats: report per-pass time and effect
+extern int dump_cfg;        // --dump-cfg: write each function's CFG to <class>.dot
+extern int inline_limit;    // --inline-limit=N: largest callee to inline, -1 for the -O default
+extern int inline_caller_limit; // --inline-caller-limit=N: stop inlining into a function this large
+extern int inline_report;   // --inline-report: list each call site and what the inliner did
+extern int unroll_budget;    // --unroll-budget=N: largest unrolled loop in IR instructions, -1 for the -O default
+extern int unroll_factor;    // --unroll=N: copies per iteration when a loop is partially unrolled
+extern int dead_code_report; // --dead-code-report: list functions and globals removed as unreachable
+
 #endif
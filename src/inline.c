@@ -0,0 +1,268 @@
+#include "opt.h"
+#include "global.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Inlining across the translation unit. Every function is lowered first;
+// then calls to small, non-recursive functions are replaced by a copy of
+// the callee's IR, before any function's pass pipeline runs. A call site
+//
+//     <args>; CALL f
+//
+// becomes
+//
+//     STORE p(n-1) ... STORE p0    (arguments into fresh locals)
+//     <body of f>                  (RETURN -> JUMP cont; the value stays on the stack)
+//   cont:
+//
+// with f's locals moved above every slot the caller already uses and its
+// labels and jump tables renumbered into the caller's. Callers are handled
+// after their callees, so a body is copied with its own calls already
+// inlined. The pipeline then cleans up the argument stores and the jumps.
+
+// Callee size limits by -O level, in instructions not counting labels
+static const int level_inline_limits[] = { 0, 12, 40 };
+
+typedef struct {
+    AST **funcs;
+    IRList *irs;
+    int count;
+    int **callees;          // distinct callees of each function
+    int *ncallees;
+    char *recursive;        // the function can reach itself through calls
+    char *falls_off;        // a non-void function whose end is reachable without a return
+    char *state;            // DFS: 0 unvisited, 1 on the path, 2 done
+    int limit;
+} Inliner;
+
+static int find_function(Inliner *in, const char *name) {
+    if (!name || is_stdlib_function(name)) return -1;
+    // Prototypes have no body to copy; only the definition counts
+    for (int k = 0; k < in->count; k++) {
+        if (in->funcs[k]->func.body && strcmp(in->funcs[k]->func.name, name) == 0) return k;
+    }
+    return -1;
+}
+
+static int code_size(IRList *ir) {
+    int n = 0;
+    for (int i = 0; i < ir->count; i++) {
+        if (ir->code[i].kind != IR_LABEL && ir->code[i].kind != IR_NOP) n++;
+    }
+    return n;
+}
+
+static void build_call_graph(Inliner *in) {
+    for (int k = 0; k < in->count; k++) {
+        IRList *ir = &in->irs[k];
+        in->callees[k] = malloc((ir->count ? ir->count : 1) * sizeof(int));
+        in->ncallees[k] = 0;
+
+        for (int i = 0; i < ir->count; i++) {
+            if (ir->code[i].kind != IR_CALL || !ir->code[i].callee) continue;
+            int c = find_function(in, ir->code[i].callee->name);
+            if (c < 0) continue;
+
+            bool seen = false;
+            for (int j = 0; j < in->ncallees[k]; j++) {
+                if (in->callees[k][j] == c) seen = true;
+            }
+            if (!seen) in->callees[k][in->ncallees[k]++] = c;
+        }
+    }
+}
+
+static bool reaches(Inliner *in, int from, int to, char *visited) {
+    for (int j = 0; j < in->ncallees[from]; j++) {
+        int c = in->callees[from][j];
+        if (c == to) return true;
+        if (visited[c]) continue;
+        visited[c] = 1;
+        if (reaches(in, c, to, visited)) return true;
+    }
+    return false;
+}
+
+// Copy callee's body into code in place of a call, with its locals starting
+// at slot base. Labels and jump tables are allocated in ir, the caller.
+static void expand_call(IRList *ir, IRList *code, AST *callee_func, IRList *callee, int base) {
+    int nparams = ir_param_slots(callee_func);
+
+    // Arguments were pushed first to last
+    AST **params = malloc((nparams ? nparams : 1) * sizeof(AST *));
+    int k = 0;
+    for (AST *p = callee_func->func.params; p; p = p->next) params[k++] = p;
+    for (k = nparams - 1; k >= 0; k--) {
+        ir_emit(code, IR_STORE_LOCAL, ir_type_of(params[k]->decl.decl_type), base + k);
+    }
+    free(params);
+
+    int offset = ir->label_count;
+    for (int l = 0; l < callee->label_count; l++) ir_new_label(ir);
+    int cont = ir_new_label(ir);
+
+    for (int i = 0; i < callee->count; i++) {
+        IRInstruction q = callee->code[i];
+
+        switch (q.kind) {
+            case IR_LOAD_LOCAL:
+            case IR_STORE_LOCAL:
+            case IR_INC:
+                q.i += base;
+                break;
+            case IR_LABEL:
+                q.i += offset;
+                break;
+            case IR_RETURN:
+            case IR_RETURN_VOID:
+                q.kind = IR_JUMP;
+                q.type = IRT_NONE;
+                q.flags = 0;
+                q.i = cont;
+                break;
+            case IR_SWITCH: {
+                IRSwitch *t = &callee->switches[q.i];
+                q.i = ir_new_switch(ir, t->default_label + offset);
+                for (int c = 0; c < t->count; c++) {
+                    ir_switch_add(ir, q.i, t->keys[c], t->labels[c] + offset);
+                }
+                break;
+            }
+            default:
+                if (ir_is_jump(q.kind)) q.i += offset;
+                break;
+        }
+        ir_append(code, &q);
+    }
+
+    ir_emit(code, IR_LABEL, IRT_NONE, cont);
+}
+
+static void inline_calls(Inliner *in, int k) {
+    IRList *ir = &in->irs[k];
+    const char *name = in->funcs[k]->func.name;
+
+    int size = code_size(ir);
+    int next_slot = ir_local_count(ir);
+    if (next_slot < ir_param_slots(in->funcs[k])) next_slot = ir_param_slots(in->funcs[k]);
+
+    IRList code;
+    irlist_init(&code);
+    int inlined = 0;
+
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        int c = p->kind == IR_CALL && p->callee ? find_function(in, p->callee->name) : -1;
+        if (c < 0) {
+            ir_append(&code, p);
+            continue;
+        }
+
+        int callee_size = code_size(&in->irs[c]);
+        const char *why = NULL;
+        if (in->recursive[c]) {
+            why = "recursive";
+        } else if (in->falls_off[c]) {
+            // Its copy would reach cont without a value on the stack
+            why = "falls off end";
+        } else if (callee_size > in->limit) {
+            why = "callee too large";
+        } else if (size + callee_size > inline_caller_limit) {
+            why = "caller too large";
+        }
+
+        if (why) {
+            if (inline_report) {
+                fprintf(stderr, "  %s: kept call to %s (%d instructions): %s\n",
+                        name, p->callee->name, callee_size, why);
+            }
+            ir_append(&code, p);
+            continue;
+        }
+
+        int slots = ir_local_count(&in->irs[c]);
+        if (slots < ir_param_slots(in->funcs[c])) slots = ir_param_slots(in->funcs[c]);
+
+        expand_call(ir, &code, in->funcs[c], &in->irs[c], next_slot);
+        next_slot += slots;
+        size += callee_size;
+        inlined++;
+
+        if (inline_report) {
+            fprintf(stderr, "  %s: inlined %s (%d instructions)\n", name, p->callee->name, callee_size);
+        }
+    }
+
+    if (inlined > 0) {
+        free(ir->code);
+        ir->code = code.code;
+        ir->count = code.count;
+        ir->capacity = code.capacity;
+        ir_resolve_labels(ir);
+    } else {
+        free(code.code);
+    }
+}
+
+// Post-order over the call graph, so callees are done before their callers
+static void visit(Inliner *in, int k) {
+    in->state[k] = 1;
+    for (int j = 0; j < in->ncallees[k]; j++) {
+        int c = in->callees[k][j];
+        if (in->state[c] == 0) visit(in, c);
+    }
+    inline_calls(in, k);
+    in->state[k] = 2;
+}
+
+void inline_functions(AST **funcs, IRList *irs, int count) {
+    int limit = inline_limit;
+    if (limit < 0) {
+        int level = opt_level < 0 ? 0 : opt_level > 2 ? 2 : opt_level;
+        limit = level_inline_limits[level];
+    }
+    if (limit == 0 || count == 0) return;
+
+    Inliner in = {
+        .funcs = funcs,
+        .irs = irs,
+        .count = count,
+        .callees = malloc(count * sizeof(int *)),
+        .ncallees = malloc(count * sizeof(int)),
+        .recursive = calloc(count, 1),
+        .falls_off = calloc(count, 1),
+        .state = calloc(count, 1),
+        .limit = limit,
+    };
+
+    build_call_graph(&in);
+
+    char *visited = malloc(count);
+    for (int k = 0; k < count; k++) {
+        memset(visited, 0, count);
+        in.recursive[k] = reaches(&in, k, k, visited);
+    }
+    free(visited);
+
+    for (int k = 0; k < count; k++) {
+        Type *ret = funcs[k]->func.return_type;
+        if (!ret || ret->kind == TY_VOID || !funcs[k]->func.body) continue;
+        CFG cfg;
+        cfg_build(&cfg, &irs[k]);
+        in.falls_off[k] = cfg_falls_off_end(&cfg);
+        cfg_free(&cfg);
+    }
+
+    if (inline_report) fprintf(stderr, "Inlining report (callee limit %d):\n", limit);
+    for (int k = 0; k < count; k++) {
+        if (in.state[k] == 0) visit(&in, k);
+    }
+
+    for (int k = 0; k < count; k++) free(in.callees[k]);
+    free(in.callees);
+    free(in.ncallees);
+    free(in.recursive);
+    free(in.falls_off);
+    free(in.state);
+}
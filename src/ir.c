@@ -1,24 +1,29 @@
 #include "ir.h"
 #include "symtab.h"
+#include "global.h"
+#include <limits.h>
 
-static int label_counter = 0;
-
-// Stack to track break/continue labels for nested loops
+// Stack to track break/continue labels for nested loops. Thread-local so
+// functions can be lowered concurrently (see -j in jbcgen.c).
 #define MAX_LOOP_DEPTH 32
-static struct {
-    char *break_label;
-    char *continue_label;
+static _Thread_local struct {
+    int break_label;
+    int continue_label;
 } loop_stack[MAX_LOOP_DEPTH];
-static int loop_depth = 0;
+static _Thread_local int loop_depth = 0;
 
-// Helper to generate unique labels
-static char* gen_label() {
-    static char buf[32];
-    snprintf(buf, sizeof(buf), "L%d", label_counter++);
-    return strdup(buf);
+// Labels are numbered per function, so the output does not depend on the
+// order functions are lowered in. Once the label table has been built, a
+// new label gets an entry of -1 (not placed yet) until it is next resolved.
+int ir_new_label(IRList *l) {
+    if (l->label_pos) {
+        l->label_pos = realloc(l->label_pos, (l->label_count + 1) * sizeof(int));
+        l->label_pos[l->label_count] = -1;
+    }
+    return l->label_count++;
 }
 
-static void push_loop(char *break_label, char *continue_label) {
+static void push_loop(int break_label, int continue_label) {
     if (loop_depth < MAX_LOOP_DEPTH) {
         loop_stack[loop_depth].break_label = break_label;
         loop_stack[loop_depth].continue_label = continue_label;
@@ -32,337 +37,626 @@ static void pop_loop() {
     }
 }
 
-static char* get_break_label() {
-    return (loop_depth > 0) ? loop_stack[loop_depth - 1].break_label : NULL;
+static int get_break_label() {
+    return (loop_depth > 0) ? loop_stack[loop_depth - 1].break_label : -1;
 }
 
-static char* get_continue_label() {
-    return (loop_depth > 0) ? loop_stack[loop_depth - 1].continue_label : NULL;
+static int get_continue_label() {
+    return (loop_depth > 0) ? loop_stack[loop_depth - 1].continue_label : -1;
 }
 
 void irlist_init(IRList *l) {
-    l->head = NULL;
-    l->tail = NULL;
+    l->code = NULL;
+    l->count = 0;
+    l->capacity = 0;
+    l->label_count = 0;
+    l->label_pos = NULL;
+    l->switches = NULL;
+    l->switch_count = 0;
 }
 
-void ir_emit(IRList *l, IRKind k, const char *s, int i) {
-    IRInstruction *n = calloc(1, sizeof(*n));
-    n->kind = k;
-    n->s = s;
-    n->i = i;
-    n->f = 0.0f;
-    n->symbol = NULL;
+void irlist_free(IRList *l) {
+    free(l->code);
+    free(l->label_pos);
+    for (int i = 0; i < l->switch_count; i++) {
+        free(l->switches[i].keys);
+        free(l->switches[i].labels);
+    }
+    free(l->switches);
+    irlist_init(l);
+}
 
-    if (!l->head)
-        l->head = l->tail = n;
-    else {
-        l->tail->next = n;
-        l->tail = n;
+// Rebuild the label id -> instruction index table
+void ir_resolve_labels(IRList *l) {
+    free(l->label_pos);
+    l->label_pos = malloc((l->label_count ? l->label_count : 1) * sizeof(int));
+    for (int i = 0; i < l->label_count; i++) {
+        l->label_pos[i] = -1;
     }
+
+    for (int i = 0; i < l->count; i++) {
+        if (l->code[i].kind == IR_LABEL) {
+            l->label_pos[l->code[i].i] = i;
+        }
+    }
+}
+
+// Index of the IR_LABEL instruction for a label id, or -1
+int ir_label_target(IRList *l, int label) {
+    if (!l->label_pos || label < 0 || label >= l->label_count) {
+        return -1;
+    }
+    return l->label_pos[label];
 }
 
-void ir_emit_with_symbol(IRList *l, IRKind k, const char *s, int i, Symbol *sym) {
-    IRInstruction *n = calloc(1, sizeof(*n));
+// Append a zeroed instruction, growing the array geometrically
+static IRInstruction *ir_append_blank(IRList *l, IRKind k, IRType t) {
+    if (l->count == l->capacity) {
+        l->capacity = l->capacity ? l->capacity * 2 : 64;
+        l->code = realloc(l->code, l->capacity * sizeof(IRInstruction));
+    }
+
+    IRInstruction *n = &l->code[l->count++];
+    memset(n, 0, sizeof(*n));
     n->kind = k;
-    n->s = s;
-    n->i = i;
-    n->f = 0.0f;
-    n->symbol = sym;
+    n->type = t;
+    return n;
+}
+
+// Append a copy of an existing instruction, which may be one of l's own
+void ir_append(IRList *l, const IRInstruction *p) {
+    IRInstruction copy = *p;
+    *ir_append_blank(l, copy.kind, copy.type) = copy;
+}
+
+void ir_emit(IRList *l, IRKind k, IRType t, int i) {
+    ir_append_blank(l, k, t)->i = i;
+}
+
+void ir_emit_name(IRList *l, IRKind k, IRType t, const char *s) {
+    ir_append_blank(l, k, t)->s = s;
+}
 
-    if (!l->head)
-        l->head = l->tail = n;
-    else {
-        l->tail->next = n;
-        l->tail = n;
+void ir_emit_float(IRList *l, float f) {
+    ir_append_blank(l, IR_PUSH_FLOAT, IRT_FLOAT)->f = f;
+}
+
+void ir_emit_call(IRList *l, Symbol *callee, int argc) {
+    IRType ret = IRT_NONE;
+    if (callee && callee->type && callee->type->kind == TY_FUNC) {
+        ret = ir_type_of(callee->type->return_type);
     }
+
+    IRInstruction *n = ir_append_blank(l, IR_CALL, ret);
+    n->i = argc;
+    n->callee = callee;
 }
 
-void ir_emit_float(IRList *l, IRKind k, float f) {
-    IRInstruction *n = calloc(1, sizeof(*n));
-    n->kind = k;
-    n->s = NULL;
-    n->i = 0;
-    n->f = f;
-    n->symbol = NULL;
+// Remove IR_NOP instructions. Passes delete instructions by turning them
+// into NOPs and let this compact the array once.
+int ir_remove_nops(IRList *l) {
+    int kept = 0;
+    for (int i = 0; i < l->count; i++) {
+        if (l->code[i].kind != IR_NOP) {
+            l->code[kept++] = l->code[i];
+        }
+    }
+
+    int removed = l->count - kept;
+    l->count = kept;
+    if (removed && l->label_pos) {
+        ir_resolve_labels(l);
+    }
+    return removed;
+}
+
+// One more than the highest local slot the IR loads or stores
+int ir_local_count(IRList *l) {
+    int n = 0;
+    for (int i = 0; i < l->count; i++) {
+        IRInstruction *p = &l->code[i];
+        if ((p->kind == IR_LOAD_LOCAL || p->kind == IR_STORE_LOCAL || p->kind == IR_INC) &&
+            p->i >= n) {
+            n = p->i + 1;
+        }
+    }
+    return n;
+}
+
+// Local slots taken by a function's parameters
+int ir_param_slots(AST *func) {
+    int n = 0;
+    if (!func || func->kind != AST_FUNC) return 0;
+    for (AST *p = func->func.params; p; p = p->next) n++;
+    return n;
+}
+
+// Number of operand stack values an instruction pops and pushes
+void ir_stack_effect(IRInstruction *p, int *pops, int *pushes) {
+    *pops = 0;
+    *pushes = 0;
+
+    switch (p->kind) {
+        case IR_PUSH_INT:
+        case IR_PUSH_FLOAT:
+        case IR_PUSH_STRING:
+        case IR_LOAD_GLOBAL:
+        case IR_LOAD_LOCAL:
+            *pushes = 1;
+            break;
+        case IR_STORE_GLOBAL:
+        case IR_STORE_LOCAL:
+        case IR_POP:
+        case IR_JUMP_IF_ZERO:
+        case IR_RETURN:
+        case IR_SWITCH:
+            *pops = 1;
+            break;
+        case IR_BR_EQ: case IR_BR_NEQ: case IR_BR_LT:
+        case IR_BR_GT: case IR_BR_LE: case IR_BR_GE:
+            *pops = (p->flags & IRF_ZERO) ? 1 : 2;
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_BIT_AND: case IR_BIT_OR: case IR_BIT_XOR: case IR_SHL: case IR_SHR:
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_ARRAY_LOAD:
+            *pops = 2;
+            *pushes = 1;
+            break;
+        case IR_NEG:
+        case IR_BIT_NOT:
+        case IR_CAST_I2F: case IR_CAST_F2I: case IR_CAST_I2D:
+        case IR_CAST_D2I: case IR_CAST_F2D: case IR_CAST_D2F:
+        case IR_ALLOC_ARRAY:
+            *pops = 1;
+            *pushes = 1;
+            break;
+        case IR_DUP:
+            *pops = 1;
+            *pushes = 2;
+            break;
+        case IR_DUP2:
+            *pops = 2;
+            *pushes = 4;
+            break;
+        case IR_DUP_X2:
+            *pops = 3;
+            *pushes = 4;
+            break;
+        case IR_ARRAY_STORE:
+            *pops = 3;
+            break;
+        case IR_ARRAY_FILL:
+            *pops = 4;
+            break;
+        case IR_ARRAY_COPY:
+            *pops = 5;
+            break;
+        case IR_CALL:
+            *pops = p->i;
+            *pushes = p->type != IRT_NONE ? 1 : 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void ir_emit_branch(IRList *l, IRKind k, IRType t, int flags, int label) {
+    IRInstruction *n = ir_append_blank(l, k, t);
+    n->flags = flags;
+    n->i = label;
+}
+
+// Start an empty jump table; returns its index for an IR_SWITCH
+int ir_new_switch(IRList *l, int default_label) {
+    l->switches = realloc(l->switches, (l->switch_count + 1) * sizeof(IRSwitch));
+    IRSwitch *t = &l->switches[l->switch_count];
+    t->keys = NULL;
+    t->labels = NULL;
+    t->count = 0;
+    t->default_label = default_label;
+    return l->switch_count++;
+}
+
+// Add a case, keeping the keys sorted. The key must not be in the table yet.
+void ir_switch_add(IRList *l, int table, int key, int label) {
+    IRSwitch *t = &l->switches[table];
+    t->keys = realloc(t->keys, (t->count + 1) * sizeof(int));
+    t->labels = realloc(t->labels, (t->count + 1) * sizeof(int));
+
+    int k = t->count++;
+    while (k > 0 && t->keys[k - 1] > key) {
+        t->keys[k] = t->keys[k - 1];
+        t->labels[k] = t->labels[k - 1];
+        k--;
+    }
+    t->keys[k] = key;
+    t->labels[k] = label;
+}
+
+// JUMP_IF_ZERO and the compare-and-branch forms
+bool ir_is_cond_branch(IRKind k) {
+    return k == IR_JUMP_IF_ZERO || (k >= IR_BR_EQ && k <= IR_BR_GE);
+}
+
+// Any instruction whose operand i is a jump target
+bool ir_is_jump(IRKind k) {
+    return k == IR_JUMP || ir_is_cond_branch(k);
+}
+
+// Number of labels an instruction can jump to: one for jumps and branches,
+// the default and every case of a switch, none for anything else
+int ir_jump_count(IRList *l, IRInstruction *p) {
+    if (ir_is_jump(p->kind)) return 1;
+    if (p->kind == IR_SWITCH) return 1 + l->switches[p->i].count;
+    return 0;
+}
 
-    if (!l->head)
-        l->head = l->tail = n;
-    else {
-        l->tail->next = n;
-        l->tail = n;
+// The k-th label an instruction can jump to, as a pointer so passes can
+// retarget it. For a switch, k = 0 is the default.
+int *ir_jump_label(IRList *l, IRInstruction *p, int k) {
+    if (p->kind != IR_SWITCH) return &p->i;
+    IRSwitch *t = &l->switches[p->i];
+    return k == 0 ? &t->default_label : &t->labels[k - 1];
+}
+
+// Make a compare-and-branch jump exactly when it used to fall through. For
+// floats the NaN case flips too: !(a < b) is "a >= b or unordered".
+void ir_invert_branch(IRInstruction *p) {
+    switch (p->kind) {
+        case IR_BR_EQ: p->kind = IR_BR_NEQ; break;
+        case IR_BR_NEQ: p->kind = IR_BR_EQ; break;
+        case IR_BR_LT: p->kind = IR_BR_GE; break;
+        case IR_BR_GE: p->kind = IR_BR_LT; break;
+        case IR_BR_GT: p->kind = IR_BR_LE; break;
+        case IR_BR_LE: p->kind = IR_BR_GT; break;
+        default: return;
+    }
+    if (p->type == IRT_FLOAT) {
+        p->flags ^= IRF_UNORDERED;
     }
 }
 
-// Helper to create a dummy symbol with just type information
-static Symbol* create_type_symbol(Type *t) {
-    Symbol *s = calloc(1, sizeof(Symbol));
-    s->name = NULL;
-    s->type = t;
-    s->is_local = false;
-    s->local_index = -1;
-    return s;
+IRType ir_type_of(Type *t) {
+    if (!t) return IRT_NONE;
+
+    switch (t->kind) {
+        case TY_INT: return IRT_INT;
+        case TY_CHAR: return IRT_CHAR;
+        case TY_FLT: return IRT_FLOAT;
+        case TY_STRUCT: return IRT_OBJECT;
+        case TY_ARRAY:
+            if (t->array_of && t->array_of->kind == TY_CHAR) return IRT_CHAR_ARRAY;
+            if (t->array_of && t->array_of->kind == TY_FLT) return IRT_FLOAT_ARRAY;
+            return IRT_INT_ARRAY;
+        default: return IRT_NONE;
+    }
+}
+
+// True for values held as JVM references (arrays and structs)
+bool ir_type_is_ref(IRType t) {
+    return t == IRT_INT_ARRAY || t == IRT_CHAR_ARRAY ||
+           t == IRT_FLOAT_ARRAY || t == IRT_OBJECT;
+}
+
+static const char *ir_type_name(IRType t) {
+    switch (t) {
+        case IRT_INT: return "int";
+        case IRT_CHAR: return "char";
+        case IRT_FLOAT: return "float";
+        case IRT_INT_ARRAY: return "int[]";
+        case IRT_CHAR_ARRAY: return "char[]";
+        case IRT_FLOAT_ARRAY: return "float[]";
+        case IRT_OBJECT: return "object";
+        default: return "";
+    }
+}
+
+// Print one instruction, without a trailing newline
+void ir_print_instr(IRInstruction *p, FILE *out) {
+    switch(p->kind) {
+        case IR_NOP:
+            fprintf(out, "NOP");
+            break;
+        case IR_LABEL:
+            fprintf(out, "LABEL L%d", p->i);
+            break;
+        case IR_JUMP:
+            fprintf(out, "JUMP L%d", p->i);
+            break;
+        case IR_JUMP_IF_ZERO:
+            fprintf(out, "JUMP_IF_ZERO L%d", p->i);
+            break;
+        case IR_LOAD_GLOBAL:
+            fprintf(out, "LOAD_GLOBAL %s", p->s ? p->s : "?");
+            break;
+        case IR_STORE_GLOBAL:
+            fprintf(out, "STORE_GLOBAL %s", p->s ? p->s : "?");
+            break;
+        case IR_LOAD_LOCAL:
+            fprintf(out, "LOAD_LOCAL %d", p->i);
+            break;
+        case IR_STORE_LOCAL:
+            fprintf(out, "STORE_LOCAL %d", p->i);
+            break;
+        case IR_INC:
+            fprintf(out, "INC %d by %d", p->i, p->imm);
+            break;
+        case IR_SWITCH:
+            fprintf(out, "SWITCH T%d", p->i);
+            break;
+        case IR_PUSH_INT:
+            fprintf(out, "PUSH_INT %d", p->i);
+            break;
+        case IR_PUSH_FLOAT:
+            fprintf(out, "PUSH_FLOAT %f", p->f);
+            break;
+        case IR_PUSH_STRING:
+            fprintf(out, "PUSH_STRING%s %s", (p->flags & IRF_COPY) ? "_COPY" : "", p->s ? p->s : "");
+            break;
+        case IR_ADD:
+            fprintf(out, "ADD");
+            break;
+        case IR_SUB:
+            fprintf(out, "SUB");
+            break;
+        case IR_MUL:
+            fprintf(out, "MUL");
+            break;
+        case IR_DIV:
+            fprintf(out, "DIV");
+            break;
+        case IR_MOD:
+            fprintf(out, "MOD");
+            break;
+        case IR_NEG:
+            fprintf(out, "NEG");
+            break;
+        case IR_BIT_AND:
+            fprintf(out, "BIT_AND");
+            break;
+        case IR_BIT_OR:
+            fprintf(out, "BIT_OR");
+            break;
+        case IR_BIT_XOR:
+            fprintf(out, "BIT_XOR");
+            break;
+        case IR_BIT_NOT:
+            fprintf(out, "BIT_NOT");
+            break;
+        case IR_SHL:
+            fprintf(out, "SHL");
+            break;
+        case IR_SHR:
+            fprintf(out, "SHR");
+            break;
+        case IR_EQ:
+            fprintf(out, "EQ");
+            break;
+        case IR_NEQ:
+            fprintf(out, "NEQ");
+            break;
+        case IR_LT:
+            fprintf(out, "LT");
+            break;
+        case IR_GT:
+            fprintf(out, "GT");
+            break;
+        case IR_LE:
+            fprintf(out, "LE");
+            break;
+        case IR_GE:
+            fprintf(out, "GE");
+            break;
+        case IR_CALL:
+            fprintf(out, "CALL %s (argc=%d)", p->callee ? p->callee->name : "?", p->i);
+            break;
+        case IR_RETURN:
+            fprintf(out, "RETURN");
+            break;
+        case IR_RETURN_VOID:
+            fprintf(out, "RETURN_VOID");
+            break;
+        case IR_POP:
+            fprintf(out, "POP");
+            break;
+        case IR_DUP:
+            fprintf(out, "DUP");
+            break;
+        case IR_DUP2:
+            fprintf(out, "DUP2");
+            break;
+        case IR_DUP_X2:
+            fprintf(out, "DUP_X2");
+            break;
+        case IR_CAST_I2F:
+            fprintf(out, "CAST_I2F");
+            break;
+        case IR_CAST_F2I:
+            fprintf(out, "CAST_F2I");
+            break;
+        case IR_CAST_I2D:
+            fprintf(out, "CAST_I2D");
+            break;
+        case IR_CAST_D2I:
+            fprintf(out, "CAST_D2I");
+            break;
+        case IR_CAST_F2D:
+            fprintf(out, "CAST_F2D");
+            break;
+        case IR_CAST_D2F:
+            fprintf(out, "CAST_D2F");
+            break;
+        case IR_ARRAY_LOAD:
+            fprintf(out, "ARRAY_LOAD");
+            break;
+        case IR_ARRAY_STORE:
+            fprintf(out, "ARRAY_STORE");
+            break;
+        case IR_ALLOC_ARRAY:
+            fprintf(out, "ALLOC_ARRAY");
+            break;
+        case IR_ARRAY_FILL:
+            fprintf(out, "ARRAY_FILL");
+            break;
+        case IR_ARRAY_COPY:
+            fprintf(out, "ARRAY_COPY");
+            break;
+        case IR_BR_EQ:
+        case IR_BR_NEQ:
+        case IR_BR_LT:
+        case IR_BR_GT:
+        case IR_BR_LE:
+        case IR_BR_GE: {
+            static const char *names[] = { "EQ", "NEQ", "LT", "GT", "LE", "GE" };
+            fprintf(out, "BR_%s%s%s L%d", names[p->kind - IR_BR_EQ],
+                    (p->flags & IRF_ZERO) ? "_ZERO" : "",
+                    (p->flags & IRF_UNORDERED) ? "_UNORDERED" : "", p->i);
+            break;
+        }
+        default:
+            fprintf(out, "UNKNOWN(%d)", p->kind);
+            break;
+    }
+
+    if (p->type != IRT_NONE) {
+        fprintf(out, " : %s", ir_type_name(p->type));
+    }
 }
 
 // Print IR in readable format for debugging
 void ir_print(IRList *ir, FILE *out) {
     if (!ir || !out) return;
-    
+
     fprintf(out, "=== IR Instructions ===\n");
-    int count = 0;
-    for (IRInstruction *p = ir->head; p; p = p->next) {
-        fprintf(out, "%3d: ", count++);
-        
-        switch(p->kind) {
-            case IR_NOP:
-                fprintf(out, "NOP\n");
-                break;
-            case IR_LABEL:
-                fprintf(out, "LABEL %s\n", p->s ? p->s : "?");
-                break;
-            case IR_JUMP:
-                fprintf(out, "JUMP %s\n", p->s ? p->s : "?");
-                break;
-            case IR_JUMP_IF_ZERO:
-                fprintf(out, "JUMP_IF_ZERO %s\n", p->s ? p->s : "?");
-                break;
-            case IR_LOAD_GLOBAL:
-                fprintf(out, "LOAD_GLOBAL %s\n", p->s ? p->s : "?");
-                break;
-            case IR_STORE_GLOBAL:
-                fprintf(out, "STORE_GLOBAL %s\n", p->s ? p->s : "?");
-                break;
-            case IR_LOAD_LOCAL:
-                fprintf(out, "LOAD_LOCAL %d\n", p->i);
-                break;
-            case IR_STORE_LOCAL:
-                fprintf(out, "STORE_LOCAL %d\n", p->i);
-                break;
-            case IR_PUSH_INT:
-                fprintf(out, "PUSH_INT %d\n", p->i);
-                break;
-            case IR_PUSH_FLOAT:
-                fprintf(out, "PUSH_FLOAT %f\n", p->f);
-                break;
-            case IR_PUSH_STRING:
-                fprintf(out, "PUSH_STRING %s\n", p->s ? p->s : "");
-                break;
-            case IR_ADD:
-                fprintf(out, "ADD\n");
-                break;
-            case IR_SUB:
-                fprintf(out, "SUB\n");
-                break;
-            case IR_MUL:
-                fprintf(out, "MUL\n");
-                break;
-            case IR_DIV:
-                fprintf(out, "DIV\n");
-                break;
-            case IR_MOD:
-                fprintf(out, "MOD\n");
-                break;
-            case IR_NEG:
-                fprintf(out, "NEG\n");
-                break;
-            case IR_BIT_AND:
-                fprintf(out, "BIT_AND\n");
-                break;
-            case IR_BIT_OR:
-                fprintf(out, "BIT_OR\n");
-                break;
-            case IR_BIT_XOR:
-                fprintf(out, "BIT_XOR\n");
-                break;
-            case IR_BIT_NOT:
-                fprintf(out, "BIT_NOT\n");
-                break;
-            case IR_SHL:
-                fprintf(out, "SHL\n");
-                break;
-            case IR_SHR:
-                fprintf(out, "SHR\n");
-                break;
-            case IR_EQ:
-                fprintf(out, "EQ\n");
-                break;
-            case IR_NEQ:
-                fprintf(out, "NEQ\n");
-                break;
-            case IR_LT:
-                fprintf(out, "LT\n");
-                break;
-            case IR_GT:
-                fprintf(out, "GT\n");
-                break;
-            case IR_LE:
-                fprintf(out, "LE\n");
-                break;
-            case IR_GE:
-                fprintf(out, "GE\n");
-                break;
-            case IR_CALL:
-                fprintf(out, "CALL %s (argc=%d)\n", p->s ? p->s : "?", p->i);
-                break;
-            case IR_RETURN:
-                fprintf(out, "RETURN\n");
-                break;
-            case IR_RETURN_VOID:
-                fprintf(out, "RETURN_VOID\n");
-                break;
-            case IR_POP:
-                fprintf(out, "POP\n");
-                break;
-            case IR_DUP:
-                fprintf(out, "DUP\n");
-                break;
-            case IR_DUP2:
-                fprintf(out, "DUP2\n");
-                break;
-            case IR_DUP_X2:
-                fprintf(out, "DUP_X2\n");
-                break;
-            case IR_CAST_I2F:
-                fprintf(out, "CAST_I2F\n");
-                break;
-            case IR_CAST_F2I:
-                fprintf(out, "CAST_F2I\n");
-                break;
-            case IR_CAST_I2D:
-                fprintf(out, "CAST_I2D\n");
-                break;
-            case IR_CAST_D2I:
-                fprintf(out, "CAST_D2I\n");
-                break;
-            case IR_CAST_F2D:
-                fprintf(out, "CAST_F2D\n");
-                break;
-            case IR_CAST_D2F:
-                fprintf(out, "CAST_D2F\n");
-                break;
-            case IR_ARRAY_LOAD:
-                fprintf(out, "ARRAY_LOAD\n");
-                break;
-            case IR_ARRAY_STORE:
-                fprintf(out, "ARRAY_STORE\n");
-                break;
-            case IR_ALLOC_ARRAY:
-                fprintf(out, "ALLOC_ARRAY size=%d\n", p->i);
-                break;
-            default:
-                fprintf(out, "UNKNOWN(%d)\n", p->kind);
-                break;
-        }
+    for (int count = 0; count < ir->count; count++) {
+        fprintf(out, "%3d: ", count);
+        ir_print_instr(&ir->code[count], out);
+        fprintf(out, "\n");
     }
     fprintf(out, "=== End IR ===\n\n");
 }
 
 static void gen_expr(AST *n, IRList *out);
 static void gen_stmt(AST *n, IRList *out);
+static void gen_branch(AST *cond, bool when_true, int label, IRList *out);
+
+// Load/store a named variable, choosing the local or global form
+static void gen_load_var(AST *id, IRList *out) {
+    Symbol *sym = id->symbol;
+    IRType t = ir_type_of(sym ? sym->type : id->type);
+
+    if (sym && sym->is_local) {
+        ir_emit(out, IR_LOAD_LOCAL, t, sym->local_index);
+    } else {
+        ir_emit_name(out, IR_LOAD_GLOBAL, t, id->id);
+    }
+}
+
+static void gen_store_var(AST *id, IRList *out) {
+    Symbol *sym = id->symbol;
+    IRType t = ir_type_of(sym ? sym->type : id->type);
+
+    if (sym && sym->is_local) {
+        ir_emit(out, IR_STORE_LOCAL, t, sym->local_index);
+    } else {
+        ir_emit_name(out, IR_STORE_GLOBAL, t, id->id);
+    }
+}
+
+// Arithmetic/bitwise instruction for a compound assignment operator
+static void gen_assign_op(AssignOpKind op, IRType t, IRList *out) {
+    switch(op) {
+        case AOP_ADD_ASSIGN: ir_emit(out, IR_ADD, t, 0); break;
+        case AOP_SUB_ASSIGN: ir_emit(out, IR_SUB, t, 0); break;
+        case AOP_MUL_ASSIGN: ir_emit(out, IR_MUL, t, 0); break;
+        case AOP_DIV_ASSIGN: ir_emit(out, IR_DIV, t, 0); break;
+        case AOP_MOD_ASSIGN: ir_emit(out, IR_MOD, t, 0); break;
+        case AOP_AND_ASSIGN: ir_emit(out, IR_BIT_AND, IRT_INT, 0); break;
+        case AOP_OR_ASSIGN: ir_emit(out, IR_BIT_OR, IRT_INT, 0); break;
+        case AOP_XOR_ASSIGN: ir_emit(out, IR_BIT_XOR, IRT_INT, 0); break;
+        case AOP_SHL_ASSIGN: ir_emit(out, IR_SHL, IRT_INT, 0); break;
+        case AOP_SHR_ASSIGN: ir_emit(out, IR_SHR, IRT_INT, 0); break;
+        default: break;
+    }
+}
 
 static void gen_binop(AST *n, IRList *out) {
     gen_expr(n->binop.left, out);
     gen_expr(n->binop.right, out);
 
-    // Pass result type with the operation
-    Symbol *type_sym = create_type_symbol(n->type);
+    // Arithmetic carries the result type, comparisons the LEFT operand
+    // type (what we're comparing)
+    IRType t = ir_type_of(n->type);
+    IRType cmp = ir_type_of(n->binop.left->type);
 
     switch(n->binop.op) {
-        case OP_ADD: ir_emit_with_symbol(out, IR_ADD, NULL, 0, type_sym); break;
-        case OP_SUB: ir_emit_with_symbol(out, IR_SUB, NULL, 0, type_sym); break;
-        case OP_MUL: ir_emit_with_symbol(out, IR_MUL, NULL, 0, type_sym); break;
-        case OP_DIV: ir_emit_with_symbol(out, IR_DIV, NULL, 0, type_sym); break;
-        case OP_MOD: ir_emit_with_symbol(out, IR_MOD, NULL, 0, type_sym); break;
-        case OP_BIT_AND: ir_emit(out, IR_BIT_AND, NULL, 0); break;
-        case OP_BIT_OR: ir_emit(out, IR_BIT_OR, NULL, 0); break;
-        case OP_BIT_XOR: ir_emit(out, IR_BIT_XOR, NULL, 0); break;
-        case OP_SHL: ir_emit(out, IR_SHL, NULL, 0); break;
-        case OP_SHR: ir_emit(out, IR_SHR, NULL, 0); break;
-                     // For comparisons, pass the LEFT operand type (what we're comparing)
-        case OP_EQ: ir_emit_with_symbol(out, IR_EQ, NULL, 0, create_type_symbol(n->binop.left->type)); break;
-        case OP_NEQ: ir_emit_with_symbol(out, IR_NEQ, NULL, 0, create_type_symbol(n->binop.left->type)); break;
-        case OP_LT: ir_emit_with_symbol(out, IR_LT, NULL, 0, create_type_symbol(n->binop.left->type)); break;
-        case OP_GT: ir_emit_with_symbol(out, IR_GT, NULL, 0, create_type_symbol(n->binop.left->type)); break;
-        case OP_LE: ir_emit_with_symbol(out, IR_LE, NULL, 0, create_type_symbol(n->binop.left->type)); break;
-        case OP_GE: ir_emit_with_symbol(out, IR_GE, NULL, 0, create_type_symbol(n->binop.left->type)); break;
+        case OP_ADD: ir_emit(out, IR_ADD, t, 0); break;
+        case OP_SUB: ir_emit(out, IR_SUB, t, 0); break;
+        case OP_MUL: ir_emit(out, IR_MUL, t, 0); break;
+        case OP_DIV: ir_emit(out, IR_DIV, t, 0); break;
+        case OP_MOD: ir_emit(out, IR_MOD, t, 0); break;
+        case OP_BIT_AND: ir_emit(out, IR_BIT_AND, IRT_INT, 0); break;
+        case OP_BIT_OR: ir_emit(out, IR_BIT_OR, IRT_INT, 0); break;
+        case OP_BIT_XOR: ir_emit(out, IR_BIT_XOR, IRT_INT, 0); break;
+        case OP_SHL: ir_emit(out, IR_SHL, IRT_INT, 0); break;
+        case OP_SHR: ir_emit(out, IR_SHR, IRT_INT, 0); break;
+        case OP_EQ: ir_emit(out, IR_EQ, cmp, 0); break;
+        case OP_NEQ: ir_emit(out, IR_NEQ, cmp, 0); break;
+        case OP_LT: ir_emit(out, IR_LT, cmp, 0); break;
+        case OP_GT: ir_emit(out, IR_GT, cmp, 0); break;
+        case OP_LE: ir_emit(out, IR_LE, cmp, 0); break;
+        case OP_GE: ir_emit(out, IR_GE, cmp, 0); break;
         default: break;
     }
 }
 
 static void gen_unary(AST *n, IRList *out) {
     gen_expr(n->unary.operand, out);
-    
-    Symbol *type_sym = create_type_symbol(n->type);
-    
+
+    IRType t = ir_type_of(n->type);
+
     switch(n->unary.op) {
         case UOP_NEG:
-            ir_emit_with_symbol(out, IR_NEG, NULL, 0, type_sym);
+            ir_emit(out, IR_NEG, t, 0);
             break;
         case UOP_BITWISE_NOT:
-            ir_emit(out, IR_BIT_NOT, NULL, 0);
+            ir_emit(out, IR_BIT_NOT, IRT_INT, 0);
             break;
         case UOP_LOGICAL_NOT:
-            ir_emit(out, IR_PUSH_INT, NULL, 0);
-            ir_emit(out, IR_EQ, NULL, 0);
+            ir_emit(out, IR_PUSH_INT, IRT_INT, 0);
+            ir_emit(out, IR_EQ, IRT_INT, 0);
             break;
         case UOP_CAST:
             if (n->unary.cast_type && n->unary.operand->type) {
                 Type *from = n->unary.operand->type;
                 Type *to = n->unary.cast_type;
-                
+
                 if (from->kind == TY_INT && to->kind == TY_FLT) {
-                    ir_emit(out, IR_CAST_I2F, NULL, 0);
+                    ir_emit(out, IR_CAST_I2F, IRT_FLOAT, 0);
                 } else if (from->kind == TY_FLT && to->kind == TY_INT) {
-                    ir_emit(out, IR_CAST_F2I, NULL, 0);
+                    ir_emit(out, IR_CAST_F2I, IRT_INT, 0);
                 }
             }
             break;
         case UOP_PRE_INC:
         case UOP_POST_INC:
-            if (n->unary.operand->kind == AST_ID) {
-                Symbol *sym = n->unary.operand->symbol;
-                if (n->unary.op == UOP_POST_INC) {
-                    ir_emit(out, IR_DUP, NULL, 0);
-                }
-                ir_emit(out, IR_PUSH_INT, NULL, 1);
-                ir_emit_with_symbol(out, IR_ADD, NULL, 0, type_sym);
-                
-                if (sym && sym->is_local) {
-                    ir_emit_with_symbol(out, IR_STORE_LOCAL, NULL, sym->local_index, sym);
-                } else {
-                    ir_emit_with_symbol(out, IR_STORE_GLOBAL, n->unary.operand->id, 0, sym);
-                }
-                
-                if (n->unary.op == UOP_PRE_INC) {
-                    if (sym && sym->is_local) {
-                        ir_emit_with_symbol(out, IR_LOAD_LOCAL, NULL, sym->local_index, sym);
-                    } else {
-                        ir_emit_with_symbol(out, IR_LOAD_GLOBAL, n->unary.operand->id, 0, sym);
-                    }
-                }
-            }
-            break;
         case UOP_PRE_DEC:
         case UOP_POST_DEC:
             if (n->unary.operand->kind == AST_ID) {
-                Symbol *sym = n->unary.operand->symbol;
-                if (n->unary.op == UOP_POST_DEC) {
-                    ir_emit(out, IR_DUP, NULL, 0);
-                }
-                ir_emit(out, IR_PUSH_INT, NULL, 1);
-                ir_emit_with_symbol(out, IR_SUB, NULL, 0, type_sym);
-                
-                if (sym && sym->is_local) {
-                    ir_emit_with_symbol(out, IR_STORE_LOCAL, NULL, sym->local_index, sym);
-                } else {
-                    ir_emit_with_symbol(out, IR_STORE_GLOBAL, n->unary.operand->id, 0, sym);
+                bool is_inc = n->unary.op == UOP_PRE_INC || n->unary.op == UOP_POST_INC;
+                bool is_post = n->unary.op == UOP_POST_INC || n->unary.op == UOP_POST_DEC;
+
+                if (is_post) {
+                    ir_emit(out, IR_DUP, IRT_NONE, 0);
                 }
-                
-                if (n->unary.op == UOP_PRE_DEC) {
-                    if (sym && sym->is_local) {
-                        ir_emit_with_symbol(out, IR_LOAD_LOCAL, NULL, sym->local_index, sym);
-                    } else {
-                        ir_emit_with_symbol(out, IR_LOAD_GLOBAL, n->unary.operand->id, 0, sym);
-                    }
+                ir_emit(out, IR_PUSH_INT, IRT_INT, 1);
+                ir_emit(out, is_inc ? IR_ADD : IR_SUB, t, 0);
+
+                gen_store_var(n->unary.operand, out);
+
+                if (!is_post) {
+                    gen_load_var(n->unary.operand, out);
                 }
             }
             break;
@@ -371,102 +665,67 @@ static void gen_unary(AST *n, IRList *out) {
     }
 }
 
+// Value about to be stored into a variable. A string literal stored into a
+// char array variable is an array the program may write, so it gets one of
+// its own rather than the shared constant.
+static void gen_stored_value(AST *value, IRList *out) {
+    gen_expr(value, out);
+    if (value->kind == AST_STRING_LITERAL) {
+        out->code[out->count - 1].flags |= IRF_COPY;
+    }
+}
+
 static void gen_assign(AST *n, IRList *out, bool need_value) {
     if (n->assign.op != AOP_ASSIGN) {
         if (n->assign.lhs->kind == AST_ARRAY_ACCESS) {
-            Symbol *array_sym = n->assign.lhs->array.array->symbol;
-            
+            IRType elem = ir_type_of(n->assign.lhs->type);
+
             gen_expr(n->assign.lhs->array.array, out);
             gen_expr(n->assign.lhs->array.index, out);
-            ir_emit(out, IR_DUP2, NULL, 0);
-            ir_emit_with_symbol(out, IR_ARRAY_LOAD, NULL, 0, array_sym);
+            ir_emit(out, IR_DUP2, IRT_NONE, 0);
+            ir_emit(out, IR_ARRAY_LOAD, elem, 0);
             gen_expr(n->assign.rhs, out);
-            
-            Symbol *type_sym = create_type_symbol(n->type);
-            
-            switch(n->assign.op) {
-                case AOP_ADD_ASSIGN: ir_emit_with_symbol(out, IR_ADD, NULL, 0, type_sym); break;
-                case AOP_SUB_ASSIGN: ir_emit_with_symbol(out, IR_SUB, NULL, 0, type_sym); break;
-                case AOP_MUL_ASSIGN: ir_emit_with_symbol(out, IR_MUL, NULL, 0, type_sym); break;
-                case AOP_DIV_ASSIGN: ir_emit_with_symbol(out, IR_DIV, NULL, 0, type_sym); break;
-                case AOP_MOD_ASSIGN: ir_emit_with_symbol(out, IR_MOD, NULL, 0, type_sym); break;
-                case AOP_AND_ASSIGN: ir_emit(out, IR_BIT_AND, NULL, 0); break;
-                case AOP_OR_ASSIGN: ir_emit(out, IR_BIT_OR, NULL, 0); break;
-                case AOP_XOR_ASSIGN: ir_emit(out, IR_BIT_XOR, NULL, 0); break;
-                case AOP_SHL_ASSIGN: ir_emit(out, IR_SHL, NULL, 0); break;
-                case AOP_SHR_ASSIGN: ir_emit(out, IR_SHR, NULL, 0); break;
-                default: break;
-            }
-            
+
+            gen_assign_op(n->assign.op, ir_type_of(n->type), out);
+
             if (need_value) {
-                ir_emit(out, IR_DUP_X2, NULL, 0);
+                ir_emit(out, IR_DUP_X2, IRT_NONE, 0);
             }
-            
-            ir_emit_with_symbol(out, IR_ARRAY_STORE, NULL, 0, array_sym);
-            
+
+            ir_emit(out, IR_ARRAY_STORE, elem, 0);
+
         } else if (n->assign.lhs->kind == AST_ID) {
-            Symbol *sym = n->assign.lhs->symbol;
-            
-            if (sym && sym->is_local) {
-                ir_emit_with_symbol(out, IR_LOAD_LOCAL, NULL, sym->local_index, sym);
-            } else {
-                ir_emit_with_symbol(out, IR_LOAD_GLOBAL, n->assign.lhs->id, 0, sym);
-            }
-            
+            gen_load_var(n->assign.lhs, out);
             gen_expr(n->assign.rhs, out);
-            
-            Symbol *type_sym = create_type_symbol(n->type);
-            
-            switch(n->assign.op) {
-                case AOP_ADD_ASSIGN: ir_emit_with_symbol(out, IR_ADD, NULL, 0, type_sym); break;
-                case AOP_SUB_ASSIGN: ir_emit_with_symbol(out, IR_SUB, NULL, 0, type_sym); break;
-                case AOP_MUL_ASSIGN: ir_emit_with_symbol(out, IR_MUL, NULL, 0, type_sym); break;
-                case AOP_DIV_ASSIGN: ir_emit_with_symbol(out, IR_DIV, NULL, 0, type_sym); break;
-                case AOP_MOD_ASSIGN: ir_emit_with_symbol(out, IR_MOD, NULL, 0, type_sym); break;
-                case AOP_AND_ASSIGN: ir_emit(out, IR_BIT_AND, NULL, 0); break;
-                case AOP_OR_ASSIGN: ir_emit(out, IR_BIT_OR, NULL, 0); break;
-                case AOP_XOR_ASSIGN: ir_emit(out, IR_BIT_XOR, NULL, 0); break;
-                case AOP_SHL_ASSIGN: ir_emit(out, IR_SHL, NULL, 0); break;
-                case AOP_SHR_ASSIGN: ir_emit(out, IR_SHR, NULL, 0); break;
-                default: break;
-            }
-            
+
+            gen_assign_op(n->assign.op, ir_type_of(n->type), out);
+
             if (need_value) {
-                ir_emit(out, IR_DUP, NULL, 0);
-            }
-            
-            if (sym && sym->is_local) {
-                ir_emit_with_symbol(out, IR_STORE_LOCAL, NULL, sym->local_index, sym);
-            } else {
-                ir_emit_with_symbol(out, IR_STORE_GLOBAL, n->assign.lhs->id, 0, sym);
+                ir_emit(out, IR_DUP, IRT_NONE, 0);
             }
+
+            gen_store_var(n->assign.lhs, out);
         }
     } else {
         if (n->assign.lhs->kind == AST_ARRAY_ACCESS) {
             gen_expr(n->assign.lhs->array.array, out);
             gen_expr(n->assign.lhs->array.index, out);
             gen_expr(n->assign.rhs, out);
-            
+
             if (need_value) {
-                ir_emit(out, IR_DUP_X2, NULL, 0);
+                ir_emit(out, IR_DUP_X2, IRT_NONE, 0);
             }
-            
-            Symbol *array_sym = n->assign.lhs->array.array->symbol;
-            ir_emit_with_symbol(out, IR_ARRAY_STORE, NULL, 0, array_sym);
-            
+
+            ir_emit(out, IR_ARRAY_STORE, ir_type_of(n->assign.lhs->type), 0);
+
         } else if (n->assign.lhs->kind == AST_ID) {
-            gen_expr(n->assign.rhs, out);
-            Symbol *sym = n->assign.lhs->symbol;
-            
+            gen_stored_value(n->assign.rhs, out);
+
             if (need_value) {
-                ir_emit(out, IR_DUP, NULL, 0);
-            }
-            
-            if (sym && sym->is_local) {
-                ir_emit_with_symbol(out, IR_STORE_LOCAL, NULL, sym->local_index, sym);
-            } else {
-                ir_emit_with_symbol(out, IR_STORE_GLOBAL, n->assign.lhs->id, 0, sym);
+                ir_emit(out, IR_DUP, IRT_NONE, 0);
             }
+
+            gen_store_var(n->assign.lhs, out);
         }
     }
 }
@@ -477,148 +736,194 @@ static void gen_call(AST *n, IRList *out) {
         gen_expr(arg, out);
         arg = arg->next;
     }
-    
-    const char *func_name = NULL;
-    Symbol *func_symbol = NULL;
-    
-    if (n->call.callee->kind == AST_ID) {
-        func_name = n->call.callee->id;
-        func_symbol = n->call.callee->symbol;
-    }
-    
-    if (func_name) {
-        ir_emit_with_symbol(out, IR_CALL, func_name, n->call.arg_count, func_symbol);
-    }
-}
-
-static void gen_logical_or(AST *n, IRList *out) {
-    char *end_label = gen_label();
-    
-    gen_expr(n->logical.left, out);
-    ir_emit(out, IR_DUP, NULL, 0);
-    
-    // If left is non-zero, result is true - skip right operand
-    ir_emit(out, IR_JUMP_IF_ZERO, end_label, 0);
-    ir_emit(out, IR_POP, NULL, 0);
-    ir_emit(out, IR_PUSH_INT, NULL, 1);
-    char *skip = gen_label();
-    ir_emit(out, IR_JUMP, skip, 0);
-    
-    ir_emit(out, IR_LABEL, end_label, 0);
-    ir_emit(out, IR_POP, NULL, 0);
-    gen_expr(n->logical.right, out);
-    
-    ir_emit(out, IR_LABEL, skip, 0);
-}
-
-static void gen_logical_and(AST *n, IRList *out) {
-    char *end_label = gen_label();
-    
-    gen_expr(n->logical.left, out);
-    ir_emit(out, IR_DUP, NULL, 0);
-    
-    // If left is zero, result is false - skip right operand
-    ir_emit(out, IR_JUMP_IF_ZERO, end_label, 0);
-    ir_emit(out, IR_POP, NULL, 0);
-    gen_expr(n->logical.right, out);
-    char *skip = gen_label();
-    ir_emit(out, IR_JUMP, skip, 0);
-    
-    ir_emit(out, IR_LABEL, end_label, 0);
-    ir_emit(out, IR_POP, NULL, 0);
-    ir_emit(out, IR_PUSH_INT, NULL, 0);
-    
-    ir_emit(out, IR_LABEL, skip, 0);
+
+    if (n->call.callee->kind == AST_ID && n->call.callee->symbol) {
+        ir_emit_call(out, n->call.callee->symbol, n->call.arg_count);
+    }
+}
+
+// && and || in value context: branch on the condition and push 0 or 1
+static void gen_logical(AST *n, IRList *out) {
+    int false_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
+    gen_branch(n, false, false_label, out);
+    ir_emit(out, IR_PUSH_INT, IRT_INT, 1);
+    ir_emit(out, IR_JUMP, IRT_NONE, end_label);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, false_label);
+    ir_emit(out, IR_PUSH_INT, IRT_INT, 0);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
 }
 
 static void gen_ternary(AST *n, IRList *out) {
-    char *false_label = gen_label();
-    char *end_label = gen_label();
-    
-    gen_expr(n->ternary.cond, out);
-    ir_emit(out, IR_JUMP_IF_ZERO, false_label, 0);
-    
+    int false_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
+    gen_branch(n->ternary.cond, false, false_label, out);
+
     gen_expr(n->ternary.iftrue, out);
-    ir_emit(out, IR_JUMP, end_label, 0);
-    
-    ir_emit(out, IR_LABEL, false_label, 0);
+    ir_emit(out, IR_JUMP, IRT_NONE, end_label);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, false_label);
     gen_expr(n->ternary.iffalse, out);
-    
-    ir_emit(out, IR_LABEL, end_label, 0);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+}
+
+static bool is_comparison(BinOpKind op) {
+    return op == OP_EQ || op == OP_NEQ || op == OP_LT ||
+           op == OP_GT || op == OP_LE || op == OP_GE;
+}
+
+static IRKind branch_kind(BinOpKind op) {
+    switch (op) {
+        case OP_EQ: return IR_BR_EQ;
+        case OP_NEQ: return IR_BR_NEQ;
+        case OP_LT: return IR_BR_LT;
+        case OP_GT: return IR_BR_GT;
+        case OP_LE: return IR_BR_LE;
+        default: return IR_BR_GE;
+    }
+}
+
+static bool is_zero_literal(AST *n) {
+    return (n->kind == AST_INT_LITERAL && n->intval == 0) ||
+           (n->kind == AST_CHAR_LITERAL && n->charval == 0);
+}
+
+// Jump to label if cond evaluates to when_true, as jumping code: &&, || and
+// ! become control flow, and a comparison feeding the jump becomes one
+// compare-and-branch, so no intermediate 0/1 is materialized.
+static void gen_branch(AST *cond, bool when_true, int label, IRList *out) {
+    if (cond->kind == AST_UNARY && cond->unary.op == UOP_LOGICAL_NOT) {
+        gen_branch(cond->unary.operand, !when_true, label, out);
+        return;
+    }
+
+    if (cond->kind == AST_LOGICAL_AND || cond->kind == AST_LOGICAL_OR) {
+        // a && b is false as soon as a is false; a || b is true as soon as
+        // a is true. If that short-circuit exit is where we jump, both
+        // operands jump straight to label; otherwise a skips past b.
+        bool short_value = cond->kind == AST_LOGICAL_OR;
+
+        if (short_value == when_true) {
+            gen_branch(cond->logical.left, when_true, label, out);
+            gen_branch(cond->logical.right, when_true, label, out);
+        } else {
+            int skip = ir_new_label(out);
+            gen_branch(cond->logical.left, short_value, skip, out);
+            gen_branch(cond->logical.right, when_true, label, out);
+            ir_emit(out, IR_LABEL, IRT_NONE, skip);
+        }
+        return;
+    }
+
+    if (cond->kind == AST_INT_LITERAL || cond->kind == AST_CHAR_LITERAL ||
+        cond->kind == AST_BOOL_LITERAL) {
+        bool value = cond->kind == AST_INT_LITERAL ? cond->intval != 0 :
+                     cond->kind == AST_CHAR_LITERAL ? cond->charval != 0 : cond->boolval;
+        if (value == when_true) {
+            ir_emit(out, IR_JUMP, IRT_NONE, label);
+        }
+        return;
+    }
+
+    if (cond->kind == AST_BINOP && is_comparison(cond->binop.op)) {
+        IRType t = ir_type_of(cond->binop.left->type);
+        int flags = 0;
+
+        gen_expr(cond->binop.left, out);
+        if (t != IRT_FLOAT && is_zero_literal(cond->binop.right)) {
+            flags |= IRF_ZERO;
+        } else {
+            gen_expr(cond->binop.right, out);
+        }
+        // C's != is the only comparison that holds when an operand is NaN
+        if (t == IRT_FLOAT && cond->binop.op == OP_NEQ) {
+            flags |= IRF_UNORDERED;
+        }
+
+        ir_emit_branch(out, branch_kind(cond->binop.op), t, flags, label);
+        if (!when_true) {
+            ir_invert_branch(&out->code[out->count - 1]);
+        }
+        return;
+    }
+
+    gen_expr(cond, out);
+
+    if (ir_type_of(cond->type) == IRT_FLOAT) {
+        ir_emit_float(out, 0.0f);
+        ir_emit_branch(out, when_true ? IR_BR_NEQ : IR_BR_EQ, IRT_FLOAT,
+                       when_true ? IRF_UNORDERED : 0, label);
+    } else if (when_true) {
+        ir_emit_branch(out, IR_BR_NEQ, IRT_INT, IRF_ZERO, label);
+    } else {
+        ir_emit(out, IR_JUMP_IF_ZERO, IRT_NONE, label);
+    }
 }
 
 static void gen_expr(AST *n, IRList *out) {
     if (!n) return;
-    
+
     switch(n->kind) {
         case AST_INT_LITERAL:
-            ir_emit(out, IR_PUSH_INT, NULL, n->intval);
+            ir_emit(out, IR_PUSH_INT, IRT_INT, n->intval);
             break;
-            
+
         case AST_FLOAT_LITERAL:
-            ir_emit_float(out, IR_PUSH_FLOAT, n->floatval);
+            ir_emit_float(out, n->floatval);
             break;
-            
+
         case AST_STRING_LITERAL:
-            ir_emit(out, IR_PUSH_STRING, n->strval, 0);
+            ir_emit_name(out, IR_PUSH_STRING, IRT_CHAR_ARRAY, n->strval);
             break;
-            
+
         case AST_CHAR_LITERAL:
-            ir_emit(out, IR_PUSH_INT, NULL, (int)n->charval);
+            ir_emit(out, IR_PUSH_INT, IRT_CHAR, (int)n->charval);
             break;
-            
+
         case AST_BOOL_LITERAL:
-            ir_emit(out, IR_PUSH_INT, NULL, n->boolval ? 1 : 0);
+            ir_emit(out, IR_PUSH_INT, IRT_INT, n->boolval ? 1 : 0);
             break;
-            
-        case AST_ID: {
-            Symbol *sym = n->symbol;
 
-            if (sym && sym->is_local) {
-                ir_emit_with_symbol(out, IR_LOAD_LOCAL, NULL, sym->local_index, sym);
-            } else {
-                ir_emit_with_symbol(out, IR_LOAD_GLOBAL, n->id, 0, sym);
-            }
+        case AST_ID:
+            gen_load_var(n, out);
             break;
-        }
-            
+
         case AST_BINOP:
             gen_binop(n, out);
             break;
-            
+
         case AST_ASSIGN:
             gen_assign(n, out, true);
             break;
-            
+
         case AST_UNARY:
             gen_unary(n, out);
             break;
-            
-        case AST_ARRAY_ACCESS: {
+
+        case AST_ARRAY_ACCESS:
             gen_expr(n->array.array, out);
             gen_expr(n->array.index, out);
-            
-            Symbol *array_sym = n->array.array->symbol;
-            ir_emit_with_symbol(out, IR_ARRAY_LOAD, NULL, 0, array_sym);
+            ir_emit(out, IR_ARRAY_LOAD, ir_type_of(n->type), 0);
             break;
-        }
-            
+
         case AST_FUNC_CALL:
             gen_call(n, out);
             break;
-            
+
         case AST_LOGICAL_OR:
-            gen_logical_or(n, out);
-            break;
-            
         case AST_LOGICAL_AND:
-            gen_logical_and(n, out);
+            gen_logical(n, out);
             break;
-            
+
         case AST_TERNARY:
             gen_ternary(n, out);
             break;
-            
+
         default:
             break;
     }
@@ -626,10 +931,11 @@ static void gen_expr(AST *n, IRList *out) {
 
 void gen_decl(AST *n, IRList *out) {
     if (!n || n->kind != AST_DECL) return;
-    
+
+    Symbol *sym = n->symbol;
+    IRType t = ir_type_of(n->decl.decl_type);
+
     if (n->decl.decl_type && n->decl.decl_type->kind == TY_ARRAY) {
-        Symbol *sym = n->symbol;
-        
         if (sym && sym->is_local) {
             int array_size;
             if(n->decl.decl_type->array_size > 0){
@@ -639,205 +945,659 @@ void gen_decl(AST *n, IRList *out) {
                 array_size = 10;
             }
 
-            ir_emit(out, IR_PUSH_INT, NULL, array_size);
-            ir_emit_with_symbol(out, IR_ALLOC_ARRAY, n->decl.name, 0, sym);
-            ir_emit_with_symbol(out, IR_STORE_LOCAL, NULL, sym->local_index, sym);
+            ir_emit(out, IR_PUSH_INT, IRT_INT, array_size);
+            ir_emit(out, IR_ALLOC_ARRAY, ir_type_of(n->decl.decl_type->array_of), 0);
+            ir_emit(out, IR_STORE_LOCAL, t, sym->local_index);
         }
     }
-    
+
     if (n->decl.init) {
-        gen_expr(n->decl.init, out);
-        
-        Symbol *sym = n->symbol;
+        gen_stored_value(n->decl.init, out);
+
         if (sym && sym->is_local) {
-            ir_emit_with_symbol(out, IR_STORE_LOCAL, NULL, sym->local_index, sym);
+            ir_emit(out, IR_STORE_LOCAL, t, sym->local_index);
         } else {
-            ir_emit_with_symbol(out, IR_STORE_GLOBAL, n->decl.name, 0, sym);
+            ir_emit_name(out, IR_STORE_GLOBAL, t, n->decl.name);
         }
     }
 }
 
 static void gen_if(AST *n, IRList *out) {
-    char *else_label = gen_label();
-    char *end_label = gen_label();
-    
-    gen_expr(n->if_stmt.cond, out);
-    ir_emit(out, IR_JUMP_IF_ZERO, else_label, 0);
-    
+    int else_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
+    gen_branch(n->if_stmt.cond, false, else_label, out);
+
     gen_stmt(n->if_stmt.then_branch, out);
-    ir_emit(out, IR_JUMP, end_label, 0);
-    
-    ir_emit(out, IR_LABEL, else_label, 0);
+    ir_emit(out, IR_JUMP, IRT_NONE, end_label);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, else_label);
     if (n->if_stmt.else_branch) {
         gen_stmt(n->if_stmt.else_branch, out);
     }
-    
-    ir_emit(out, IR_LABEL, end_label, 0);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
 }
 
+// Loops are rotated: a guard test skips the loop when the condition is
+// false on entry, and the condition is tested again at the bottom, so each
+// iteration takes a single backward branch:
+//
+//     if (!cond) goto end
+//   body:
+//     ...
+//   cont:                 (continue target)
+//     if (cond) goto body
+//   end:
 static void gen_while(AST *n, IRList *out) {
-    char *start_label = gen_label();
-    char *end_label = gen_label();
-    
-    push_loop(end_label, start_label);
-    
-    ir_emit(out, IR_LABEL, start_label, 0);
-    gen_expr(n->while_stmt.cond, out);
-    ir_emit(out, IR_JUMP_IF_ZERO, end_label, 0);
-    
+    int body_label = ir_new_label(out);
+    int cont_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
+    push_loop(end_label, cont_label);
+
+    gen_branch(n->while_stmt.cond, false, end_label, out);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, body_label);
     gen_stmt(n->while_stmt.body, out);
-    ir_emit(out, IR_JUMP, start_label, 0);
-    
-    ir_emit(out, IR_LABEL, end_label, 0);
-    
+
+    ir_emit(out, IR_LABEL, IRT_NONE, cont_label);
+    gen_branch(n->while_stmt.cond, true, body_label, out);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+
     pop_loop();
 }
 
 static void gen_do_while(AST *n, IRList *out) {
-    char *start_label = gen_label();
-    char *cond_label = gen_label();
-    char *end_label = gen_label();
-    
+    int start_label = ir_new_label(out);
+    int cond_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
     push_loop(end_label, cond_label);
-    
-    ir_emit(out, IR_LABEL, start_label, 0);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, start_label);
     gen_stmt(n->do_while.body, out);
-    
-    ir_emit(out, IR_LABEL, cond_label, 0);
-    gen_expr(n->do_while.cond, out);
-    ir_emit(out, IR_JUMP_IF_ZERO, end_label, 0);
-    ir_emit(out, IR_JUMP, start_label, 0);
-    
-    ir_emit(out, IR_LABEL, end_label, 0);
-    
+
+    ir_emit(out, IR_LABEL, IRT_NONE, cond_label);
+    gen_branch(n->do_while.cond, true, start_label, out);
+
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+
     pop_loop();
 }
 
+static void gen_for_post(AST *n, IRList *out) {
+    if (!n->for_stmt.post) return;
+    if (n->for_stmt.post->kind == AST_ASSIGN ||
+        n->for_stmt.post->kind == AST_UNARY ||
+        n->for_stmt.post->kind == AST_FUNC_CALL) {
+        gen_stmt(n->for_stmt.post, out);
+    } else {
+        gen_expr(n->for_stmt.post, out);
+        ir_emit(out, IR_POP, IRT_NONE, 0);
+    }
+}
+
+// Largest unrolled loop, in IR instructions, by -O level
+static const int level_unroll_budgets[] = { 0, 64, 160 };
+
+// for (i = start; i <op> bound; i += step) with i an int local the body
+// never writes, running trips times
+typedef struct {
+    AST *var;
+    long long start;
+    long long step;
+    long long trips;
+} CountedLoop;
+
+static bool int_constant(AST *n, long long *v) {
+    if (n->kind == AST_INT_LITERAL) {
+        *v = n->intval;
+        return true;
+    }
+    if (n->kind == AST_UNARY && n->unary.op == UOP_NEG && int_constant(n->unary.operand, v)) {
+        *v = -*v;
+        return true;
+    }
+    return false;
+}
+
+static bool is_var(AST *n, AST *var) {
+    return n && n->kind == AST_ID && n->symbol && n->symbol->is_local &&
+           n->symbol->local_index == var->symbol->local_index;
+}
+
+static bool blocks_unrolling(AST *n, AST *var);
+
+static bool list_blocks_unrolling(AST *n, AST *var) {
+    for (; n; n = n->next) {
+        if (blocks_unrolling(n, var)) return true;
+    }
+    return false;
+}
+
+// True if n might write var, or holds a loop of its own
+static bool blocks_unrolling(AST *n, AST *var) {
+    if (!n) return false;
+
+    switch (n->kind) {
+        case AST_FOR: case AST_WHILE: case AST_DO_WHILE:
+            return true;
+        case AST_ASSIGN:
+            return is_var(n->assign.lhs, var) ||
+                   blocks_unrolling(n->assign.lhs, var) || blocks_unrolling(n->assign.rhs, var);
+        case AST_UNARY:
+            if ((n->unary.op == UOP_PRE_INC || n->unary.op == UOP_POST_INC ||
+                 n->unary.op == UOP_PRE_DEC || n->unary.op == UOP_POST_DEC ||
+                 n->unary.op == UOP_ADDR) && is_var(n->unary.operand, var)) {
+                return true;
+            }
+            return blocks_unrolling(n->unary.operand, var);
+        case AST_BINOP:
+            return blocks_unrolling(n->binop.left, var) || blocks_unrolling(n->binop.right, var);
+        case AST_LOGICAL_OR: case AST_LOGICAL_AND:
+            return blocks_unrolling(n->logical.left, var) || blocks_unrolling(n->logical.right, var);
+        case AST_TERNARY:
+            return blocks_unrolling(n->ternary.cond, var) || blocks_unrolling(n->ternary.iftrue, var) ||
+                   blocks_unrolling(n->ternary.iffalse, var);
+        case AST_ARRAY_ACCESS:
+            return blocks_unrolling(n->array.array, var) || blocks_unrolling(n->array.index, var);
+        case AST_MEMBER_ACCESS:
+            return blocks_unrolling(n->member.object, var);
+        case AST_FUNC_CALL:
+            return list_blocks_unrolling(n->call.args, var);
+        case AST_DECL:
+            return blocks_unrolling(n->decl.init, var);
+        case AST_BLOCK:
+            for (int k = 0; k < n->block.count; k++) {
+                if (blocks_unrolling(n->block.statements[k], var)) return true;
+            }
+            return false;
+        case AST_IF:
+            return blocks_unrolling(n->if_stmt.cond, var) || blocks_unrolling(n->if_stmt.then_branch, var) ||
+                   blocks_unrolling(n->if_stmt.else_branch, var);
+        case AST_RETURN:
+            return blocks_unrolling(n->ret.expr, var);
+        case AST_SWITCH:
+            return blocks_unrolling(n->switch_stmt.expr, var) || list_blocks_unrolling(n->switch_stmt.cases, var);
+        case AST_CASE:
+            return blocks_unrolling(n->case_stmt.body, var);
+        default:
+            return false;
+    }
+}
+
+static bool counted_loop(AST *n, CountedLoop *c) {
+    AST *init = n->for_stmt.init, *cond = n->for_stmt.cond, *post = n->for_stmt.post;
+    if (!init || !cond || !post) return false;
+
+    if (init->kind != AST_ASSIGN || init->assign.op != AOP_ASSIGN) return false;
+    AST *var = init->assign.lhs;
+    if (var->kind != AST_ID || !var->symbol || !var->symbol->is_local ||
+        ir_type_of(var->symbol->type) != IRT_INT) return false;
+    long long start, bound, step;
+    if (!int_constant(init->assign.rhs, &start)) return false;
+
+    if (cond->kind != AST_BINOP || !is_var(cond->binop.left, var) ||
+        !int_constant(cond->binop.right, &bound)) return false;
+
+    if (post->kind == AST_UNARY && is_var(post->unary.operand, var) &&
+        (post->unary.op == UOP_PRE_INC || post->unary.op == UOP_POST_INC)) {
+        step = 1;
+    } else if (post->kind == AST_UNARY && is_var(post->unary.operand, var) &&
+               (post->unary.op == UOP_PRE_DEC || post->unary.op == UOP_POST_DEC)) {
+        step = -1;
+    } else if (post->kind == AST_ASSIGN && is_var(post->assign.lhs, var) &&
+               (post->assign.op == AOP_ADD_ASSIGN || post->assign.op == AOP_SUB_ASSIGN) &&
+               int_constant(post->assign.rhs, &step)) {
+        if (post->assign.op == AOP_SUB_ASSIGN) step = -step;
+    } else {
+        return false;
+    }
+    if (step == 0) return false;
+
+    // Iterations until the condition first fails; a step heading away from
+    // the bound would wrap around instead
+    long long trips;
+    switch (cond->binop.op) {
+        case OP_LE: bound++;    // fall through
+        case OP_LT:
+            if (step < 0) return false;
+            trips = bound > start ? (bound - start + step - 1) / step : 0;
+            break;
+        case OP_GE: bound--;    // fall through
+        case OP_GT:
+            if (step > 0) return false;
+            trips = start > bound ? (start - bound - step - 1) / -step : 0;
+            break;
+        case OP_NEQ:
+            if ((bound - start) % step != 0 || (bound - start) / step < 0) return false;
+            trips = (bound - start) / step;
+            break;
+        default:
+            return false;
+    }
+
+    long long last = start + trips * step;
+    if (last < INT_MIN || last > INT_MAX) return false;
+    if (blocks_unrolling(n->for_stmt.body, var)) return false;
+
+    c->var = var;
+    c->start = start;
+    c->step = step;
+    c->trips = trips;
+    return true;
+}
+
+// Body and post of one iteration, with continue jumping to the post
+static void gen_iteration(AST *n, int end_label, IRList *out) {
+    int next_label = ir_new_label(out);
+    push_loop(end_label, next_label);
+    gen_stmt(n->for_stmt.body, out);
+    pop_loop();
+    ir_emit(out, IR_LABEL, IRT_NONE, next_label);
+    gen_for_post(n, out);
+}
+
+// Instructions one iteration lowers to, labels aside
+static int iteration_size(AST *n, IRList *out) {
+    IRList scratch;
+    irlist_init(&scratch);
+    scratch.label_count = out->label_count;
+    gen_iteration(n, 0, &scratch);
+
+    int size = 0;
+    for (int i = 0; i < scratch.count; i++) {
+        if (scratch.code[i].kind != IR_LABEL) size++;
+    }
+    irlist_free(&scratch);
+    return size;
+}
+
+// Unroll a counted loop whose copies fit the budget. Few enough trips are
+// unrolled completely, leaving straight-line code for the later passes to
+// fold i into; otherwise the loop runs factor copies per test and the
+// trips % factor left over follow it:
+//
+//     i = start
+//   body:
+//     <body; post> x factor
+//     if (i < start + trips / factor * factor * step) goto body
+//     <body; post> x (trips % factor)
+//   end:                  (break target)
+static bool gen_unrolled_for(AST *n, IRList *out) {
+    int budget = unroll_budget >= 0 ? unroll_budget :
+                 level_unroll_budgets[opt_level < 0 ? 0 : opt_level > 2 ? 2 : opt_level];
+    CountedLoop c;
+    if (budget <= 0 || !counted_loop(n, &c)) return false;
+
+    int size = iteration_size(n, out);
+    int copies = c.trips, factor = 0;
+    if (c.trips * size > budget) {
+        for (factor = unroll_factor; factor >= 2; factor--) {
+            copies = factor + c.trips % factor;
+            if (c.trips / factor >= 2 && copies * size <= budget) break;
+        }
+        if (factor < 2) return false;
+    }
+
+    gen_stmt(n->for_stmt.init, out);
+    int body_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
+    if (factor == 0) {
+        for (long long k = 0; k < c.trips; k++) gen_iteration(n, end_label, out);
+    } else {
+        ir_emit(out, IR_LABEL, IRT_NONE, body_label);
+        for (int k = 0; k < factor; k++) gen_iteration(n, end_label, out);
+        gen_load_var(c.var, out);
+        ir_emit(out, IR_PUSH_INT, IRT_INT, (int)(c.start + c.trips / factor * factor * c.step));
+        ir_emit_branch(out, c.step > 0 ? IR_BR_LT : IR_BR_GT, IRT_INT, 0, body_label);
+        for (int k = 0; k < c.trips % factor; k++) gen_iteration(n, end_label, out);
+    }
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+    return true;
+}
+
+// A constant, or a variable other than var: the same value on every
+// iteration of a loop that writes nothing but array elements
+static bool is_loop_constant(AST *n, AST *var) {
+    long long v;
+    if (n->kind == AST_CHAR_LITERAL || n->kind == AST_FLOAT_LITERAL || int_constant(n, &v)) return true;
+    return n->kind == AST_ID && !is_var(n, var) && !ir_type_is_ref(ir_type_of(n->type));
+}
+
+static bool is_array_var(AST *n) {
+    return n->kind == AST_ID && ir_type_is_ref(ir_type_of(n->type)) && ir_type_of(n->type) != IRT_OBJECT;
+}
+
+// An index var + d for a constant d
+static bool index_offset(AST *n, AST *var, long long *d) {
+    if (is_var(n, var)) {
+        *d = 0;
+        return true;
+    }
+    if (n->kind != AST_BINOP) return false;
+    if (n->binop.op == OP_ADD && is_var(n->binop.left, var) && int_constant(n->binop.right, d)) return true;
+    if (n->binop.op == OP_ADD && is_var(n->binop.right, var) && int_constant(n->binop.left, d)) return true;
+    if (n->binop.op == OP_SUB && is_var(n->binop.left, var) && int_constant(n->binop.right, d)) {
+        *d = -*d;
+        return true;
+    }
+    return false;
+}
+
+// Push base + d
+static void gen_offset(AST *base, long long d, IRList *out) {
+    gen_expr(base, out);
+    if (d != 0) {
+        ir_emit(out, IR_PUSH_INT, IRT_INT, (int)d);
+        ir_emit(out, IR_ADD, IRT_INT, 0);
+    }
+}
+
+// Loops that only fill or copy a range of an array become one library call,
+// which the JVM runs as an intrinsic:
+//
+//     for (i = s; i < n; i++) a[i + d] = v;          Arrays.fill(a, s + d, n + d, v)
+//     for (i = s; i < n; i++) b[i + d] = a[i + e];   System.arraycopy(a, s + e, b, s + d, n - s)
+//
+// The call is guarded by the loop condition and followed by i = n, so i
+// ends where the loop leaves it. s, n and v are read once instead of every
+// iteration, so they must be constants or variables other than i. The
+// copy behaves as if through a temporary array, which a forward loop only
+// matches if d <= e: copying a[i + 1] = a[i] upwards smears a[s] across
+// the range instead.
+static bool gen_array_idiom(AST *n, IRList *out) {
+    AST *init = n->for_stmt.init, *cond = n->for_stmt.cond, *post = n->for_stmt.post;
+    AST *body = n->for_stmt.body;
+    if (opt_level < 1 || !init || !cond || !post || !body) return false;
+
+    if (init->kind != AST_ASSIGN || init->assign.op != AOP_ASSIGN) return false;
+    AST *var = init->assign.lhs;
+    if (var->kind != AST_ID || !var->symbol || !var->symbol->is_local ||
+        ir_type_of(var->symbol->type) != IRT_INT) return false;
+
+    AST *bound = cond->kind == AST_BINOP ? cond->binop.right : NULL;
+    if (!bound || (cond->binop.op != OP_LT && cond->binop.op != OP_LE) || !is_var(cond->binop.left, var) ||
+        !is_loop_constant(init->assign.rhs, var) || !is_loop_constant(bound, var) ||
+        ir_type_of(init->assign.rhs->type) != IRT_INT || ir_type_of(bound->type) != IRT_INT) return false;
+    long long past = cond->binop.op == OP_LE ? 1 : 0;
+
+    long long step = 0;
+    if (post->kind == AST_UNARY && is_var(post->unary.operand, var) &&
+        (post->unary.op == UOP_PRE_INC || post->unary.op == UOP_POST_INC)) {
+        step = 1;
+    } else if (post->kind == AST_ASSIGN && post->assign.op == AOP_ADD_ASSIGN && is_var(post->assign.lhs, var)) {
+        int_constant(post->assign.rhs, &step);
+    }
+    if (step != 1) return false;
+
+    if (body->kind == AST_BLOCK && body->block.count == 1) body = body->block.statements[0];
+    if (body->kind != AST_ASSIGN || body->assign.op != AOP_ASSIGN) return false;
+    AST *dst = body->assign.lhs, *value = body->assign.rhs;
+    long long d, e;
+    if (dst->kind != AST_ARRAY_ACCESS || !is_array_var(dst->array.array) ||
+        !index_offset(dst->array.index, var, &d) || d < -INT_MAX || d > INT_MAX) return false;
+    IRType elem = ir_type_of(dst->type);
+
+    AST *src = NULL;
+    if (value->kind == AST_ARRAY_ACCESS) {
+        src = value->array.array;
+        if (!is_array_var(src) || ir_type_of(src->type) != ir_type_of(dst->array.array->type) ||
+            !index_offset(value->array.index, var, &e) || e < -INT_MAX || e > INT_MAX) return false;
+        // Array variables can be assigned, so any two may be the same array
+        if (d > e) return false;
+    } else if (!is_loop_constant(value, var) || ir_type_of(value->type) != elem) {
+        return false;
+    }
+
+    int end_label = ir_new_label(out);
+    gen_stmt(init, out);
+    gen_branch(cond, false, end_label, out);
+
+    if (src) {
+        gen_expr(src, out);
+        gen_offset(var, e, out);
+        gen_expr(dst->array.array, out);
+        gen_offset(var, d, out);
+        gen_offset(bound, past, out);
+        gen_load_var(var, out);
+        ir_emit(out, IR_SUB, IRT_INT, 0);
+        ir_emit(out, IR_ARRAY_COPY, elem, 0);
+    } else {
+        gen_expr(dst->array.array, out);
+        gen_offset(var, d, out);
+        gen_offset(bound, past + d, out);
+        gen_expr(value, out);
+        ir_emit(out, IR_ARRAY_FILL, elem, 0);
+    }
+
+    gen_offset(bound, past, out);
+    gen_store_var(var, out);
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+    return true;
+}
+
+// Rotated like gen_while, with the post expression before the bottom test
 static void gen_for(AST *n, IRList *out) {
-    char *start_label = gen_label();
-    char *post_label = gen_label();
-    char *end_label = gen_label();
-    
+    if (gen_array_idiom(n, out) || gen_unrolled_for(n, out)) return;
+
+    int body_label = ir_new_label(out);
+    int post_label = ir_new_label(out);
+    int end_label = ir_new_label(out);
+
     // Init
     if (n->for_stmt.init) {
         gen_stmt(n->for_stmt.init, out);
     }
-    
+
     push_loop(end_label, post_label);
-    
-    // Condition check
-    ir_emit(out, IR_LABEL, start_label, 0);
+
+    // Guard
     if (n->for_stmt.cond) {
-        gen_expr(n->for_stmt.cond, out);
-        ir_emit(out, IR_JUMP_IF_ZERO, end_label, 0);
+        gen_branch(n->for_stmt.cond, false, end_label, out);
     }
-    
+
     // Body
+    ir_emit(out, IR_LABEL, IRT_NONE, body_label);
     gen_stmt(n->for_stmt.body, out);
-    
+
     // Post (continue jumps here)
-    ir_emit(out, IR_LABEL, post_label, 0);
-    if (n->for_stmt.post) {
-        if (n->for_stmt.post->kind == AST_ASSIGN || 
-            n->for_stmt.post->kind == AST_UNARY ||
-            n->for_stmt.post->kind == AST_FUNC_CALL) {
-            gen_stmt(n->for_stmt.post, out);
-        } else {
-            gen_expr(n->for_stmt.post, out);
-            ir_emit(out, IR_POP, NULL, 0);
+    ir_emit(out, IR_LABEL, IRT_NONE, post_label);
+    gen_for_post(n, out);
+
+    // Bottom test
+    if (n->for_stmt.cond) {
+        gen_branch(n->for_stmt.cond, true, body_label, out);
+    } else {
+        ir_emit(out, IR_JUMP, IRT_NONE, body_label);
+    }
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+
+    pop_loop();
+}
+
+// Switches with this many cases or fewer on a plain variable are lowered
+// to a compare chain instead of a jump table
+#define SWITCH_CHAIN_MAX 3
+
+static int case_key(AST *value) {
+    return value->kind == AST_CHAR_LITERAL ? value->charval : value->intval;
+}
+
+// The scrutinee is tested once through a jump table (see emit_switch in
+// jbcgen.c), or reloaded for each compare when there are only a few cases:
+//
+//     <expr>                    load x; push k1; if == goto L1
+//     switch T: k1 -> L1 ...    load x; push k2; if == goto L2
+//               default -> Ld   goto Ld
+//   L1: body1                 L1: body1
+//   L2: body2  (fall through) L2: body2
+//   ...
+//   end:                      (break target)
+static void gen_switch(AST *n, IRList *out) {
+    AST *expr = n->switch_stmt.expr;
+    int end_label = ir_new_label(out);
+    int default_label = end_label;
+    int ncases = 0;
+
+    for (AST *c = n->switch_stmt.cases; c; c = c->next) ncases++;
+    int *labels = malloc((ncases ? ncases : 1) * sizeof(int));
+
+    int k = 0, nkeys = 0;
+    for (AST *c = n->switch_stmt.cases; c; c = c->next, k++) {
+        labels[k] = ir_new_label(out);
+        if (c->case_stmt.value) nkeys++; else default_label = labels[k];
+    }
+
+    bool reload = expr->kind == AST_ID && (ir_type_of(expr->type) == IRT_INT ||
+                                           ir_type_of(expr->type) == IRT_CHAR);
+    if (reload && nkeys <= SWITCH_CHAIN_MAX) {
+        k = 0;
+        for (AST *c = n->switch_stmt.cases; c; c = c->next, k++) {
+            if (!c->case_stmt.value) continue;
+            gen_expr(expr, out);
+            ir_emit(out, IR_PUSH_INT, IRT_INT, case_key(c->case_stmt.value));
+            ir_emit_branch(out, IR_BR_EQ, IRT_INT, 0, labels[k]);
+        }
+        ir_emit(out, IR_JUMP, IRT_NONE, default_label);
+    } else {
+        int table = ir_new_switch(out, default_label);
+        k = 0;
+        for (AST *c = n->switch_stmt.cases; c; c = c->next, k++) {
+            if (c->case_stmt.value) ir_switch_add(out, table, case_key(c->case_stmt.value), labels[k]);
         }
+        gen_expr(expr, out);
+        ir_emit(out, IR_SWITCH, IRT_INT, table);
+    }
+
+    // break leaves the switch; continue still belongs to the enclosing loop
+    push_loop(end_label, get_continue_label());
+    k = 0;
+    for (AST *c = n->switch_stmt.cases; c; c = c->next, k++) {
+        ir_emit(out, IR_LABEL, IRT_NONE, labels[k]);
+        gen_stmt(c->case_stmt.body, out);
     }
-    
-    ir_emit(out, IR_JUMP, start_label, 0);
-    ir_emit(out, IR_LABEL, end_label, 0);
-    
     pop_loop();
+
+    ir_emit(out, IR_LABEL, IRT_NONE, end_label);
+    free(labels);
 }
 
 static void gen_stmt(AST *n, IRList *out) {
     if (!n) return;
-    
+
     switch(n->kind) {
         case AST_DECL:
             gen_decl(n, out);
             break;
-            
+
         case AST_RETURN:
             if (n->ret.expr) {
                 gen_expr(n->ret.expr, out);
-                ir_emit(out, IR_RETURN, NULL, 0);
+                ir_emit(out, IR_RETURN, ir_type_of(n->ret.expr->type), 0);
             } else {
-                ir_emit(out, IR_RETURN_VOID, NULL, 0);
+                ir_emit(out, IR_RETURN_VOID, IRT_NONE, 0);
             }
             break;
-            
+
         case AST_BREAK: {
-            char *break_label = get_break_label();
-            if (break_label) {
-                ir_emit(out, IR_JUMP, break_label, 0);
+            int break_label = get_break_label();
+            if (break_label >= 0) {
+                ir_emit(out, IR_JUMP, IRT_NONE, break_label);
             }
             break;
         }
-            
+
         case AST_CONTINUE: {
-            char *continue_label = get_continue_label();
-            if (continue_label) {
-                ir_emit(out, IR_JUMP, continue_label, 0);
+            int continue_label = get_continue_label();
+            if (continue_label >= 0) {
+                ir_emit(out, IR_JUMP, IRT_NONE, continue_label);
             }
             break;
         }
-            
+
         case AST_IF:
             gen_if(n, out);
             break;
-            
+
         case AST_WHILE:
             gen_while(n, out);
             break;
-            
+
         case AST_DO_WHILE:
             gen_do_while(n, out);
             break;
-            
+
         case AST_FOR:
             gen_for(n, out);
             break;
-            
+
+        case AST_SWITCH:
+            gen_switch(n, out);
+            break;
+
         case AST_BLOCK:
             for (int i = 0; i < n->block.count; i++) {
                 gen_stmt(n->block.statements[i], out);
             }
             break;
-            
+
         case AST_FUNC_CALL:
             gen_expr(n, out);
-            if(n->type && n->type->kind != TY_VOID && n->func.return_type && n->func.return_type->kind != TY_VOID){
-                ir_emit(out, IR_POP, NULL, 0);
+            // Discard the result of a call made for its side effects
+            if (out->count > 0 && out->code[out->count - 1].kind == IR_CALL &&
+                out->code[out->count - 1].type != IRT_NONE) {
+                ir_emit(out, IR_POP, IRT_NONE, 0);
             }
             break;
-            
+
         case AST_ASSIGN:
             gen_assign(n, out, false);
             break;
-            
+
         case AST_UNARY:
             gen_expr(n, out);
-            ir_emit(out, IR_POP, NULL, 0);
+            ir_emit(out, IR_POP, IRT_NONE, 0);
             break;
-            
+
         default:
             break;
     }
 }
 
+// C lets a function that returns a value run off its end, as long as the
+// caller does not use the result; the JVM rejects such a method. An int,
+// char or float function whose code does not end in a jump or return gets
+// a return of zero there.
+static void gen_default_return(AST *func, IRList *out) {
+    IRType t = ir_type_of(func->func.return_type);
+    if (t != IRT_INT && t != IRT_CHAR && t != IRT_FLOAT) return;
+
+    if (out->count > 0) {
+        IRKind k = out->code[out->count - 1].kind;
+        if (k == IR_RETURN || k == IR_JUMP || k == IR_SWITCH) return;
+    }
+
+    if (t == IRT_FLOAT) {
+        ir_emit_float(out, 0.0f);
+    } else {
+        ir_emit(out, IR_PUSH_INT, IRT_INT, 0);
+    }
+    ir_emit(out, IR_RETURN, t, 0);
+}
+
 void generate_ir_from_ast(AST *ast, IRList *out) {
     if (!ast) return;
-    
+
     irlist_init(out);
-    
+
     if (ast->kind == AST_FUNC) {
         if (ast->func.body) {
             gen_stmt(ast->func.body, out);
+            gen_default_return(ast, out);
         }
     } else {
         gen_stmt(ast, out);
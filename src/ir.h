@@ -55,30 +55,113 @@ typedef enum {
     IR_ARRAY_LOAD,     
     IR_ARRAY_STORE,   
     IR_ALLOC_ARRAY,  
+    IR_ARRAY_FILL,      // pop value, to, from, array; set array[from..to) to value
+    IR_ARRAY_COPY,      // pop length, dst pos, dst, src pos, src; copy as if through a temporary
+    IR_BR_EQ,           // compare-and-branch: pop b, a; jump to label i if a == b
+    IR_BR_NEQ,
+    IR_BR_LT,
+    IR_BR_GT,
+    IR_BR_LE,
+    IR_BR_GE,
+    IR_INC,             // add imm to int local i in place (iinc)
+    IR_SWITCH,          // pop an int and jump through jump table i of the IRList
+    IR_NUM_KINDS,       // not an instruction; keep last
 } IRKind;
 
+// Operand type carried directly on each instruction: the result type for
+// arithmetic, the operand type for comparisons, the variable type for loads
+// and stores, the element type for array operations and the value type for
+// returns.
+typedef enum {
+    IRT_NONE,
+    IRT_INT,
+    IRT_CHAR,
+    IRT_FLOAT,
+    IRT_INT_ARRAY,
+    IRT_CHAR_ARRAY,
+    IRT_FLOAT_ARRAY,
+    IRT_OBJECT,         // struct values
+} IRType;
+
+// Instructions are small fixed-size records stored contiguously in an
+// IRList, 16 bytes each on 64-bit targets.
 typedef struct IRInstruction {
-    IRKind kind;
-    const char *s;  // optional symbol (variable name, function name, etc.)
-    int i;          // optional integer literal or local variable index
-    float f;        // optional float literal
-    struct Symbol *symbol;
-    struct IRInstruction *next;
+    unsigned char kind;     // IRKind
+    unsigned char type;     // IRType
+    unsigned char flags;    // IRF_* bits
+    int i;                  // integer literal, local index, label id or argument count
+    union {
+        float f;            // float literal
+        const char *s;      // global name or string literal (owned by the AST)
+        Symbol *callee;     // function symbol for IR_CALL (owned by the AST)
+        int imm;            // increment for IR_INC
+    };
 } IRInstruction;
 
+// Flags for compare-and-branch instructions
+#define IRF_ZERO        0x01    // compare the single popped value against zero
+#define IRF_UNORDERED   0x02    // float compare that also jumps if an operand is NaN
+
+// Flag for IR_PUSH_STRING
+#define IRF_COPY        0x04    // a new array of its own rather than the shared constant
+
+// Jump table of an IR_SWITCH: jump to labels[k] when the value equals
+// keys[k], otherwise to default_label. Keys are sorted and distinct.
+typedef struct {
+    int *keys;
+    int *labels;
+    int count;
+    int default_label;
+} IRSwitch;
+
+// The IR of one function. Labels are dense ids numbered per function:
+// 0 .. label_count-1. label_pos maps each id to the index of its IR_LABEL
+// instruction (-1 if the label is not placed); it is filled in by
+// ir_resolve_labels() and must be rebuilt after instructions move.
 typedef struct {
-    IRInstruction *head;
-    IRInstruction *tail;
+    IRInstruction *code;
+    int count;
+    int capacity;
+    int label_count;
+    int *label_pos;
+    IRSwitch *switches;     // jump tables, indexed by IR_SWITCH's i
+    int switch_count;
 } IRList;
 
 void irlist_init(IRList *l);
-void ir_emit(IRList *l, IRKind k, const char *s, int i);
-void ir_emit_with_symbol(IRList *l, IRKind k, const char *s, int i, Symbol *sym);
-void ir_emit_float(IRList *l, IRKind k, float f);
+void irlist_free(IRList *l);
+
+int ir_new_label(IRList *l);
+void ir_resolve_labels(IRList *l);
+int ir_label_target(IRList *l, int label);
+
+void ir_append(IRList *l, const IRInstruction *p);
+void ir_emit(IRList *l, IRKind k, IRType t, int i);
+void ir_emit_name(IRList *l, IRKind k, IRType t, const char *s);
+void ir_emit_float(IRList *l, float f);
+void ir_emit_call(IRList *l, Symbol *callee, int argc);
+void ir_emit_branch(IRList *l, IRKind k, IRType t, int flags, int label);
+int ir_new_switch(IRList *l, int default_label);
+void ir_switch_add(IRList *l, int table, int key, int label);
+
+bool ir_is_cond_branch(IRKind k);
+bool ir_is_jump(IRKind k);
+int ir_jump_count(IRList *l, IRInstruction *p);
+int *ir_jump_label(IRList *l, IRInstruction *p, int k);
+void ir_invert_branch(IRInstruction *p);
+
+int ir_remove_nops(IRList *l);
+void ir_stack_effect(IRInstruction *p, int *pops, int *pushes);
+int ir_local_count(IRList *l);
+int ir_param_slots(AST *func);
+
+IRType ir_type_of(Type *t);
+bool ir_type_is_ref(IRType t);
 
 void generate_ir_from_ast(AST *ast, IRList *out);
 
 void ir_print(IRList *ir, FILE *out);
+void ir_print_instr(IRInstruction *p, FILE *out);
 
 // Generate IR for local declarations
 void gen_decl(AST *n, IRList *out);
@@ -1,8 +1,13 @@
 #include "jbcgen.h"
 #include "symtab.h"
 #include "ast.h"
+#include "global.h"
+#include "cfg.h"
+#include "opt.h"
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
 
 // Extract class name from filename (removes path and .j extension)
 static char* get_classname_from_output(const char *filename) {
@@ -24,12 +29,48 @@ void codegen_error(const char *msg, AST *node) {
             ast_get_line_no(node), msg);
 }
 
-// Helper function to check if an IR instruction operates on floats
-static bool is_float_operation(IRInstruction *p) {
-    if (!p->symbol || !p->symbol->type) {
-        return false;
+// A set of function and global names, small enough for linear search
+typedef struct {
+    const char **names;
+    int count;
+    int capacity;
+} NameSet;
+
+static bool nameset_contains(const NameSet *set, const char *name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) return true;
+    }
+    return false;
+}
+
+static void nameset_add(NameSet *set, const char *name) {
+    if (!name || nameset_contains(set, name)) return;
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 16;
+        set->names = realloc(set->names, set->capacity * sizeof(const char *));
+    }
+    set->names[set->count++] = name;
+}
+
+// Functions and globals reachable from main. Filled in before anything is
+// written when dead code is removed (-O1 and up); otherwise everything is live.
+static bool prune_dead = false;
+static NameSet live;
+
+static bool is_live(const char *name) {
+    return !prune_dead || nameset_contains(&live, name);
+}
+
+// Distinct string literals of the class, in order of first use. Each is
+// converted to a char[] once, in <clinit>, into field str$<index>. Filled
+// in before the workers start; they only read it.
+static NameSet strings;
+
+static int string_index(const char *literal) {
+    for (int i = 0; i < strings.count; i++) {
+        if (strcmp(strings.names[i], literal) == 0) return i;
     }
-    return p->symbol->type->kind == TY_FLT;
+    return -1;
 }
 
 void emit_class_header(FILE *out, const char *classname) {
@@ -86,7 +127,7 @@ static const char* get_type_descriptor(Type *type) {
     }
 }
 
-void emit_method_header(FILE *out, const char *classname, const char *name, Type *return_type, AST *params) {
+void emit_method_header(FILE *out, const char *classname, const char *name, Type *return_type, AST *params, int stack, int locals) {
     fprintf(out, "\n.method public static %s : (", name);
     
     // Emit parameter types
@@ -99,7 +140,7 @@ void emit_method_header(FILE *out, const char *classname, const char *name, Type
     }
     
     fprintf(out, ")%s\n", get_type_descriptor(return_type));
-    fprintf(out, ".code stack 32 locals 32\n");
+    fprintf(out, ".code stack %d locals %d\n", stack, locals);
 }
 
 void emit_method_footer(FILE *out) {
@@ -107,49 +148,94 @@ void emit_method_footer(FILE *out) {
     fprintf(out, ".end method\n");
 }
 
-static void emit_comparison(FILE *out, IRKind kind, IRInstruction *instr) {
-    static int label_counter = 10000;
-    int true_label = label_counter++;
-    int end_label = label_counter++;
+// Condition suffix of the JVM if<cond>/if_icmp<cond> opcodes
+static const char *branch_condition(IRKind kind) {
+    switch(kind) {
+        case IR_EQ: case IR_BR_EQ: return "eq";
+        case IR_NEQ: case IR_BR_NEQ: return "ne";
+        case IR_LT: case IR_BR_LT: return "lt";
+        case IR_GT: case IR_BR_GT: return "gt";
+        case IR_LE: case IR_BR_LE: return "le";
+        default: return "ge";
+    }
+}
 
-    // Check if comparing floats
-    bool is_float = false;
-    if (instr->symbol && instr->symbol->type && instr->symbol->type->kind == TY_FLT) {
-        is_float = true;
+// fcmpl pushes -1 and fcmpg pushes 1 for NaN. Pick the one that makes the
+// following if<cond> fail on NaN (ordered) or succeed on NaN (unordered).
+static const char *float_compare(IRKind kind, bool unordered) {
+    switch(kind) {
+        case IR_LT: case IR_LE: case IR_BR_LT: case IR_BR_LE:
+            return unordered ? "fcmpl" : "fcmpg";
+        case IR_GT: case IR_GE: case IR_BR_GT: case IR_BR_GE:
+            return unordered ? "fcmpg" : "fcmpl";
+        default:
+            // Either works: NaN compares unequal
+            return "fcmpl";
     }
+}
+
+// Compare-and-branch: one if_icmp<cond>, or if<cond> after fcmp or
+// against zero
+static void emit_branch(FILE *out, IRInstruction *p) {
+    const char *cond = branch_condition(p->kind);
 
-    if (is_float) {
-        // For float comparison: first use fcmpl to convert to -1, 0, or 1
-        fprintf(out, "    fcmpl\n");
+    if (p->type == IRT_FLOAT) {
+        fprintf(out, "    %s\n", float_compare(p->kind, p->flags & IRF_UNORDERED));
+        fprintf(out, "    if%s L%d\n", cond, p->i);
+    } else if (p->flags & IRF_ZERO) {
+        fprintf(out, "    if%s L%d\n", cond, p->i);
+    } else {
+        fprintf(out, "    if_icmp%s L%d\n", cond, p->i);
     }
+}
 
-    const char *cmp_instr;
-    switch(kind) {
-        case IR_EQ: cmp_instr = "ifeq"; break;
-        case IR_NEQ: cmp_instr = "ifne"; break;
-        case IR_LT: cmp_instr = "iflt"; break;
-        case IR_GT: cmp_instr = "ifgt"; break;
-        case IR_LE: cmp_instr = "ifle"; break;
-        case IR_GE: cmp_instr = "ifge"; break;
-        default: return;
-    }
-
-    if (is_float) {
-        // After fcmpl, we have a single int on stack - use single-operand comparison
-        fprintf(out, "    %s L%d\n", cmp_instr, true_label);
+// tableswitch when the keys are dense enough, lookupswitch otherwise. The
+// cost model is javac's: table space plus three times its (constant) time
+// against the same for a lookupswitch.
+static void emit_switch(FILE *out, IRList *ir, IRInstruction *p) {
+    IRSwitch *t = &ir->switches[p->i];
+
+    if (t->count == 0) {
+        fprintf(out, "    pop\n");
+        fprintf(out, "    goto L%d\n", t->default_label);
+        return;
+    }
+
+    long lo = t->keys[0], hi = t->keys[t->count - 1];
+    long table_cost = 4 + (hi - lo + 1) + 3 * 3;
+    long lookup_cost = 3 + 2 * (long)t->count + 3 * (long)t->count;
+
+    if (table_cost <= lookup_cost) {
+        fprintf(out, "    tableswitch %ld\n", lo);
+        int k = 0;
+        for (long key = lo; key <= hi; key++) {
+            if (t->keys[k] == key) {
+                fprintf(out, "        L%d\n", t->labels[k++]);
+            } else {
+                fprintf(out, "        L%d\n", t->default_label);
+            }
+        }
     } else {
-        // For integers, use two-operand comparison
-        const char *int_cmp;
-        switch(kind) {
-            case IR_EQ: int_cmp = "if_icmpeq"; break;
-            case IR_NEQ: int_cmp = "if_icmpne"; break;
-            case IR_LT: int_cmp = "if_icmplt"; break;
-            case IR_GT: int_cmp = "if_icmpgt"; break;
-            case IR_LE: int_cmp = "if_icmple"; break;
-            case IR_GE: int_cmp = "if_icmpge"; break;
-            default: return;
+        fprintf(out, "    lookupswitch\n");
+        for (int k = 0; k < t->count; k++) {
+            fprintf(out, "        %d : L%d\n", t->keys[k], t->labels[k]);
         }
-        fprintf(out, "    %s L%d\n", int_cmp, true_label);
+    }
+    fprintf(out, "        default : L%d\n", t->default_label);
+}
+
+// Comparison labels are allocated from the function's own label ids, so they
+// never collide with IR labels and stay the same however functions are scheduled.
+static void emit_comparison(FILE *out, IRKind kind, IRInstruction *instr, IRList *ir) {
+    int true_label = ir_new_label(ir);
+    int end_label = ir_new_label(ir);
+
+    if (instr->type == IRT_FLOAT) {
+        // C comparisons other than != are false when an operand is NaN
+        fprintf(out, "    %s\n", float_compare(kind, kind == IR_NEQ));
+        fprintf(out, "    if%s L%d\n", branch_condition(kind), true_label);
+    } else {
+        fprintf(out, "    if_icmp%s L%d\n", branch_condition(kind), true_label);
     }
 
     fprintf(out, "    iconst_0\n");
@@ -159,65 +245,128 @@ static void emit_comparison(FILE *out, IRKind kind, IRInstruction *instr) {
     fprintf(out, "\nL%d:\n", end_label);
 }
 
-static const char *array_load_opcode(Type *array_type) {
-    if (!array_type || array_type->kind != TY_ARRAY) {
-        return "iaload";
+// ldc of a float. Folded constants can be any float, so print enough
+// digits to round trip and spell out the special values.
+static void emit_float_constant(FILE *out, float f) {
+    char buf[64];
+
+    if (isnan(f)) {
+        fprintf(out, "    ldc +NaNf\n");
+    } else if (isinf(f)) {
+        fprintf(out, "    ldc %cInfinityf\n", f > 0 ? '+' : '-');
+    } else {
+        snprintf(buf, sizeof(buf), "%.9g", f);
+        // The assembler needs a decimal point to read a float literal
+        char *e = strchr(buf, 'e');
+        if (!strchr(buf, '.')) {
+            if (e) {
+                fprintf(out, "    ldc %.*s.0%sf\n", (int)(e - buf), buf, e);
+            } else {
+                fprintf(out, "    ldc %s.0f\n", buf);
+            }
+        } else {
+            fprintf(out, "    ldc %sf\n", buf);
+        }
     }
-    
-    Type *elem = array_type->array_of;
-    if (!elem) {
-        return "iaload";
+}
+
+// Descriptor of a value carried by an IR type tag (globals, locals)
+static const char *ir_type_descriptor(IRType t) {
+    switch (t) {
+        case IRT_FLOAT: return "F";
+        case IRT_CHAR: return "C";
+        case IRT_INT_ARRAY: return "[I";
+        case IRT_CHAR_ARRAY: return "[C";
+        case IRT_FLOAT_ARRAY: return "[F";
+        case IRT_OBJECT: return "Ljava/lang/Object;";
+        default: return "I";
     }
-    
-    if (elem->kind == TY_INT)   return "iaload";
-    if (elem->kind == TY_CHAR)  return "caload";
-    if (elem->kind == TY_FLT)   return "faload";
-    return "aaload";
 }
 
-static const char *array_store_opcode(Type *array_type) {
-    if (!array_type || array_type->kind != TY_ARRAY) {
-        return "iastore";
+// Opcode prefix for loads, stores and returns of a value of this type
+static char ir_type_prefix(IRType t) {
+    if (t == IRT_FLOAT) return 'f';
+    if (ir_type_is_ref(t)) return 'a';
+    return 'i';
+}
+
+static const char *array_load_opcode(IRType elem) {
+    switch (elem) {
+        case IRT_CHAR: return "caload";
+        case IRT_FLOAT: return "faload";
+        case IRT_NONE:
+        case IRT_INT: return "iaload";
+        default: return "aaload";
     }
-    
-    Type *elem = array_type->array_of;
-    if (!elem) {
-        return "iastore";
+}
+
+static const char *array_store_opcode(IRType elem) {
+    switch (elem) {
+        case IRT_CHAR: return "castore";
+        case IRT_FLOAT: return "fastore";
+        case IRT_NONE:
+        case IRT_INT: return "iastore";
+        default: return "aastore";
     }
-    
-    if (elem->kind == TY_INT)   return "iastore";
-    if (elem->kind == TY_CHAR)  return "castore";
-    if (elem->kind == TY_FLT)   return "fastore";
-    return "aastore";
 }
 
-static const char *newarray_type(Type *elem_type) {
-    if (!elem_type) return "int";
-    
-    switch (elem_type->kind) {
-        case TY_INT: return "int";
-        case TY_CHAR: return "char";
-        case TY_FLT: return "float";
+// Arrays.fill overload for an element type
+static const char *array_fill_descriptor(IRType elem) {
+    switch (elem) {
+        case IRT_CHAR: return "([CIIC)V";
+        case IRT_FLOAT: return "([FIIF)V";
+        default: return "([IIII)V";
+    }
+}
+
+static const char *newarray_type(IRType elem) {
+    switch (elem) {
+        case IRT_CHAR: return "char";
+        case IRT_FLOAT: return "float";
         default: return "int";
     }
 }
 
 void emit_java_from_ir(FILE *out, const char *classname, IRList *ir) {
-    for (IRInstruction *p = ir->head; p; p = p->next) {
+    ir_resolve_labels(ir);
+
+    for (IRInstruction *p = ir->code; p < ir->code + ir->count; p++) {
         switch(p->kind) {
             case IR_LABEL:
                 // Emit label
-                fprintf(out, "%s:\n", p->s);
+                fprintf(out, "L%d:\n", p->i);
                 break;
                 
             case IR_JUMP:
+                if (ir_label_target(ir, p->i) < 0) {
+                    fprintf(stderr, "Code generation error: jump to undefined label L%d\n", p->i);
+                }
                 // Unconditional jump
-                fprintf(out, "    goto %s\n", p->s);
+                fprintf(out, "    goto L%d\n", p->i);
                 break;
                 
+            case IR_BR_EQ:
+            case IR_BR_NEQ:
+            case IR_BR_LT:
+            case IR_BR_GT:
+            case IR_BR_LE:
+            case IR_BR_GE:
+                if (ir_label_target(ir, p->i) < 0) {
+                    fprintf(stderr, "Code generation error: jump to undefined label L%d\n", p->i);
+                }
+                emit_branch(out, p);
+                break;
+
+            case IR_SWITCH:
+                emit_switch(out, ir, p);
+                break;
+
             case IR_JUMP_IF_ZERO:
+                if (ir_label_target(ir, p->i) < 0) {
+                    fprintf(stderr, "Code generation error: jump to undefined label L%d\n", p->i);
+                }
                 // Conditional jump if top of stack is zero
-                fprintf(out, "    ifeq %s\n", p->s);
+                fprintf(out, "    ifeq L%d\n", p->i);
                 break;
                 
             case IR_PUSH_INT:
@@ -235,117 +384,106 @@ void emit_java_from_ir(FILE *out, const char *classname, IRList *ir) {
                 break;
                 
             case IR_PUSH_FLOAT:
-                if (p->f == 0.0f) {
+                if (p->f == 0.0f && !signbit(p->f)) {
                     fprintf(out, "    fconst_0\n");
                 } else if (p->f == 1.0f) {
                     fprintf(out, "    fconst_1\n");
                 } else if (p->f == 2.0f) {
                     fprintf(out, "    fconst_2\n");
                 } else {
-                    fprintf(out, "    ldc %ff\n", p->f);
+                    emit_float_constant(out, p->f);
                 }
                 break;
                 
-            case IR_PUSH_STRING:
-                fprintf(out, "    ldc %s\n", p->s);
-                fprintf(out, "    invokestatic Method lib440 java2c (Ljava/lang/String;)[C\n");
-                break;
-                
-            case IR_LOAD_GLOBAL: {
-                const char *type_desc = "I";
-                if (p->symbol && p->symbol->type) {
-                    type_desc = get_type_descriptor(p->symbol->type);
+            case IR_PUSH_STRING: {
+                int k = (p->flags & IRF_COPY) ? -1 : string_index(p->s);
+                if (k >= 0) {
+                    fprintf(out, "    getstatic Field %s str$%d [C\n", classname, k);
+                } else {
+                    fprintf(out, "    ldc %s\n", p->s);
+                    fprintf(out, "    invokestatic Method lib440 java2c (Ljava/lang/String;)[C\n");
                 }
-                fprintf(out, "    getstatic Field %s %s %s\n", classname, p->s, type_desc);
                 break;
             }
                 
-            case IR_STORE_GLOBAL: {
-                const char *type_desc = "I";
-                if (p->symbol && p->symbol->type) {
-                    type_desc = get_type_descriptor(p->symbol->type);
-                }
-                fprintf(out, "    putstatic Field %s %s %s\n", classname, p->s, type_desc);
+            case IR_LOAD_GLOBAL:
+                fprintf(out, "    getstatic Field %s %s %s\n", classname, p->s, ir_type_descriptor(p->type));
                 break;
-            }
                 
-            case IR_LOAD_LOCAL: {
-                if (p->symbol && p->symbol->type && p->symbol->type->kind == TY_FLT) {
-                    if (p->i >= 0 && p->i <= 3) {
-                        fprintf(out, "    fload_%d\n", p->i);
-                    } else {
-                        fprintf(out, "    fload %d\n", p->i);
-                    }
+            case IR_STORE_GLOBAL:
+                fprintf(out, "    putstatic Field %s %s %s\n", classname, p->s, ir_type_descriptor(p->type));
+                break;
+                
+            case IR_LOAD_LOCAL:
+                if (p->i >= 0 && p->i <= 3) {
+                    fprintf(out, "    %cload_%d\n", ir_type_prefix(p->type), p->i);
+                } else if (p->i <= 255) {
+                    fprintf(out, "    %cload %d\n", ir_type_prefix(p->type), p->i);
                 } else {
-                    if (p->i >= 0 && p->i <= 3) {
-                        fprintf(out, "    iload_%d\n", p->i);
-                    } else {
-                        fprintf(out, "    iload %d\n", p->i);
-                    }
+                    fprintf(out, "    wide %cload %d\n", ir_type_prefix(p->type), p->i);
                 }
                 break;
-            }
-                
-            case IR_STORE_LOCAL: {
-                if (p->symbol && p->symbol->type && p->symbol->type->kind == TY_FLT) {
-                    if (p->i >= 0 && p->i <= 3) {
-                        fprintf(out, "    fstore_%d\n", p->i);
-                    } else {
-                        fprintf(out, "    fstore %d\n", p->i);
-                    }
+
+            case IR_STORE_LOCAL:
+                if (p->i >= 0 && p->i <= 3) {
+                    fprintf(out, "    %cstore_%d\n", ir_type_prefix(p->type), p->i);
+                } else if (p->i <= 255) {
+                    fprintf(out, "    %cstore %d\n", ir_type_prefix(p->type), p->i);
                 } else {
-                    if (p->i >= 0 && p->i <= 3) {
-                        fprintf(out, "    istore_%d\n", p->i);
-                    } else {
-                        fprintf(out, "    istore %d\n", p->i);
-                    }
+                    fprintf(out, "    wide %cstore %d\n", ir_type_prefix(p->type), p->i);
                 }
                 break;
-            }
 
-            case IR_ARRAY_LOAD: {
-                Type *array_type = (p->symbol && p->symbol->type) ? p->symbol->type : NULL;
-                fprintf(out, "    %s\n", array_load_opcode(array_type));
+            case IR_INC:
+                if (p->i <= 255 && p->imm >= -128 && p->imm <= 127) {
+                    fprintf(out, "    iinc %d %d\n", p->i, p->imm);
+                } else {
+                    fprintf(out, "    wide iinc %d %d\n", p->i, p->imm);
+                }
                 break;
-            }
-                
-            case IR_ARRAY_STORE: {
-                Type *array_type = (p->symbol && p->symbol->type) ? p->symbol->type : NULL;
-                fprintf(out, "    %s\n", array_store_opcode(array_type));
+
+            case IR_ARRAY_LOAD:
+                fprintf(out, "    %s\n", array_load_opcode(p->type));
                 break;
-            }
-            
-            case IR_ALLOC_ARRAY: {
-                Type *elem_type = NULL;
-                if (p->symbol && p->symbol->type && p->symbol->type->kind == TY_ARRAY) {
-                    elem_type = p->symbol->type->array_of;
-                }
-                fprintf(out, "    newarray %s\n", newarray_type(elem_type));
+
+            case IR_ARRAY_STORE:
+                fprintf(out, "    %s\n", array_store_opcode(p->type));
                 break;
-            }
-                
+
+            case IR_ALLOC_ARRAY:
+                fprintf(out, "    newarray %s\n", newarray_type(p->type));
+                break;
+
+            case IR_ARRAY_FILL:
+                fprintf(out, "    invokestatic Method java/util/Arrays fill %s\n", array_fill_descriptor(p->type));
+                break;
+
+            case IR_ARRAY_COPY:
+                fprintf(out, "    invokestatic Method java/lang/System arraycopy (Ljava/lang/Object;ILjava/lang/Object;II)V\n");
+                break;
+
             case IR_ADD:
-                fprintf(out, "    %s\n", is_float_operation(p) ? "fadd" : "iadd");
+                fprintf(out, "    %s\n", p->type == IRT_FLOAT ? "fadd" : "iadd");
                 break;
                 
             case IR_SUB:
-                fprintf(out, "    %s\n", is_float_operation(p) ? "fsub" : "isub");
+                fprintf(out, "    %s\n", p->type == IRT_FLOAT ? "fsub" : "isub");
                 break;
                 
             case IR_MUL:
-                fprintf(out, "    %s\n", is_float_operation(p) ? "fmul" : "imul");
+                fprintf(out, "    %s\n", p->type == IRT_FLOAT ? "fmul" : "imul");
                 break;
                 
             case IR_DIV:
-                fprintf(out, "    %s\n", is_float_operation(p) ? "fdiv" : "idiv");
+                fprintf(out, "    %s\n", p->type == IRT_FLOAT ? "fdiv" : "idiv");
                 break;
                 
             case IR_MOD:
-                fprintf(out, "    %s\n", is_float_operation(p) ? "frem" : "irem");
+                fprintf(out, "    %s\n", p->type == IRT_FLOAT ? "frem" : "irem");
                 break;
                 
             case IR_NEG:
-                fprintf(out, "    %s\n", is_float_operation(p) ? "fneg" : "ineg");
+                fprintf(out, "    %s\n", p->type == IRT_FLOAT ? "fneg" : "ineg");
                 break;
                 
             case IR_BIT_AND:
@@ -379,51 +517,49 @@ void emit_java_from_ir(FILE *out, const char *classname, IRList *ir) {
             case IR_GT:
             case IR_LE:
             case IR_GE:
-                emit_comparison(out, p->kind, p);
+                emit_comparison(out, p->kind, p, ir);
                 break;
                 
-            case IR_CALL:
-                if (is_stdlib_function(p->s)) {
-                    if (strcmp(p->s, "getchar") == 0) {
+            case IR_CALL: {
+                const char *name = p->callee->name;
+                Type *ft = p->callee->type;
+
+                if (is_stdlib_function(name)) {
+                    if (strcmp(name, "getchar") == 0) {
                         fprintf(out, "    invokestatic Method lib440 getchar ()I\n");
-                    } else if (strcmp(p->s, "putchar") == 0) {
+                    } else if (strcmp(name, "putchar") == 0) {
                         fprintf(out, "    invokestatic Method lib440 putchar (I)I\n");
-                    } else if (strcmp(p->s, "getint") == 0) {
+                    } else if (strcmp(name, "getint") == 0) {
                         fprintf(out, "    invokestatic Method lib440 getint ()I\n");
-                    } else if (strcmp(p->s, "putint") == 0) {
+                    } else if (strcmp(name, "putint") == 0) {
                         fprintf(out, "    invokestatic Method lib440 putint (I)V\n");
-                    } else if (strcmp(p->s, "getfloat") == 0) {
+                    } else if (strcmp(name, "getfloat") == 0) {
                         fprintf(out, "    invokestatic Method lib440 getfloat ()F\n");
-                    } else if (strcmp(p->s, "putfloat") == 0) {
+                    } else if (strcmp(name, "putfloat") == 0) {
                         fprintf(out, "    invokestatic Method lib440 putfloat (F)V\n");
-                    } else if (strcmp(p->s, "putstring") == 0) {
+                    } else if (strcmp(name, "putstring") == 0) {
                         fprintf(out, "    invokestatic Method lib440 putstring ([C)V\n");
                     }
+                } else if (ft && ft->kind == TY_FUNC) {
+                    fprintf(out, "    invokestatic Method %s %s (", classname, name);
+                    // Use actual parameter types from function signature
+                    for (int i = 0; i < ft->param_count; i++) {
+                        fprintf(out, "%s", get_type_descriptor(ft->params[i]));
+                    }
+                    fprintf(out, ")%s\n", get_type_descriptor(ft->return_type));
                 } else {
-                    const char *return_desc = "I";
-
-                    if (p->symbol && p->symbol->type && p->symbol->type->kind == TY_FUNC) {
-                        return_desc = get_type_descriptor(p->symbol->type->return_type);
-
-                        fprintf(out, "    invokestatic Method %s %s (", classname, p->s);
-                        // Use actual parameter types from function signature
-                        for (int i = 0; i < p->symbol->type->param_count; i++) {
-                            fprintf(out, "%s", get_type_descriptor(p->symbol->type->params[i]));
-                        }
-                        fprintf(out, ")%s\n", return_desc);
-                    } else {
-                        // Fallback if no symbol info
-                        fprintf(out, "    invokestatic Method %s %s (", classname, p->s);
-                        for (int i = 0; i < p->i; i++) {
-                            fprintf(out, "I");
-                        }
-                        fprintf(out, ")%s\n", return_desc);
+                    // Fallback if no signature info
+                    fprintf(out, "    invokestatic Method %s %s (", classname, name);
+                    for (int i = 0; i < p->i; i++) {
+                        fprintf(out, "I");
                     }
+                    fprintf(out, ")I\n");
                 }
                 break;
+            }
 
             case IR_RETURN:
-                fprintf(out, "    ireturn\n");
+                fprintf(out, "    %creturn\n", ir_type_prefix(p->type));
                 break;
                 
             case IR_RETURN_VOID:
@@ -461,31 +597,38 @@ void emit_java_from_ir(FILE *out, const char *classname, IRList *ir) {
 }
 
 void emit_static_initializer(FILE *out, const char *classname, AST *program) {
-    bool has_arrays = false;
+    bool needed = false;
     
     for (AST *n = program; n != NULL; n = n->next) {
-        if (n->kind == AST_DECL && n->decl.decl_type && n->decl.decl_type->kind == TY_ARRAY) {
-            has_arrays = true;
+        if (n->kind == AST_DECL && n->decl.decl_type && n->decl.decl_type->kind == TY_ARRAY &&
+            is_live(n->decl.name)) {
+            needed = true;
             break;
         } else if (n->kind == AST_BLOCK) {
             for (int i = 0; i < n->block.count; i++) {
                 AST *stmt = n->block.statements[i];
-                if (stmt->kind == AST_DECL && stmt->decl.decl_type && stmt->decl.decl_type->kind == TY_ARRAY) {
-                    has_arrays = true;
+                if (stmt->kind == AST_DECL && stmt->decl.decl_type && stmt->decl.decl_type->kind == TY_ARRAY &&
+                    is_live(stmt->decl.name)) {
+                    needed = true;
                     break;
                 }
             }
-            if (has_arrays) break;
+            if (needed) break;
         }
     }
     
-    if (!has_arrays) return;
+    // Global arrays are allocated and string literals converted here
+    for (int k = 0; k < strings.count && !needed; k++) {
+        needed = is_live(strings.names[k]);
+    }
+    if (!needed) return;
     
     fprintf(out, "\n.method static <clinit> : ()V\n");
-    fprintf(out, ".code stack 10 locals 0\n");
+    fprintf(out, ".code stack 1 locals 0\n");
     
     for (AST *n = program; n != NULL; n = n->next) {
-        if (n->kind == AST_DECL && n->decl.decl_type && n->decl.decl_type->kind == TY_ARRAY) {
+        if (n->kind == AST_DECL && n->decl.decl_type && n->decl.decl_type->kind == TY_ARRAY &&
+            is_live(n->decl.name)) {
             int array_size = n->decl.decl_type->array_size > 0 ? 
                             n->decl.decl_type->array_size : 10;
             
@@ -513,7 +656,8 @@ void emit_static_initializer(FILE *out, const char *classname, AST *program) {
         } else if (n->kind == AST_BLOCK) {
             for (int i = 0; i < n->block.count; i++) {
                 AST *stmt = n->block.statements[i];
-                if (stmt->kind == AST_DECL && stmt->decl.decl_type && stmt->decl.decl_type->kind == TY_ARRAY) {
+                if (stmt->kind == AST_DECL && stmt->decl.decl_type && stmt->decl.decl_type->kind == TY_ARRAY &&
+                    is_live(stmt->decl.name)) {
                     int array_size = stmt->decl.decl_type->array_size > 0 ? 
                                     stmt->decl.decl_type->array_size : 10;
                     
@@ -543,6 +687,13 @@ void emit_static_initializer(FILE *out, const char *classname, AST *program) {
         }
     }
     
+    for (int k = 0; k < strings.count; k++) {
+        if (!is_live(strings.names[k])) continue;
+        fprintf(out, "    ldc %s\n", strings.names[k]);
+        fprintf(out, "    invokestatic Method lib440 java2c (Ljava/lang/String;)[C\n");
+        fprintf(out, "    putstatic Field %s str$%d [C\n", classname, k);
+    }
+    
     fprintf(out, "    return\n");
     fprintf(out, ".end code\n");
     fprintf(out, ".end method\n");
@@ -568,48 +719,266 @@ void emit_java_main(FILE *out, const char *classname) {
     fprintf(out, ".end method\n");
 }
 
-static void generate_function(FILE *out, AST *func, const char *classname) {
+// Operand stack effect of the bytecode emitted for p. Calls pop what the
+// callee's signature says, since that is the descriptor invokestatic uses.
+static void jvm_stack_effect(IRInstruction *p, int *pops, int *pushes) {
+    ir_stack_effect(p, pops, pushes);
+
+    if (p->kind == IR_CALL && p->callee && p->callee->type && p->callee->type->kind == TY_FUNC &&
+        !is_stdlib_function(p->callee->name)) {
+        Type *ft = p->callee->type;
+        *pops = ft->param_count;
+        *pushes = ft->return_type && ft->return_type->kind != TY_VOID ? 1 : 0;
+    }
+}
+
+// Highest operand stack depth the method reaches, found by simulating the
+// stack along the CFG. Every path into a block must arrive with the same
+// depth; anything else is a bug in lowering or a pass, and is reported.
+static int max_stack_depth(IRList *ir, const char *func_name) {
+    CFG cfg;
+    cfg_build(&cfg, ir);
+    StackDepths d;
+    cfg_stack_depths(&cfg, jvm_stack_effect, &d);
+
+    if (d.underflow >= 0) {
+        fprintf(stderr, "Internal compiler error: function %s: operand stack underflow at IR instruction %d\n",
+                func_name, d.underflow);
+    }
+    if (d.edge_from >= 0) {
+        fprintf(stderr, "Internal compiler error: function %s: operand stack depth %d on edge B%d -> B%d but %d on another path\n",
+                func_name, d.edge_depth, d.edge_from, d.edge_to, d.other_depth);
+    }
+
+    // ~x is emitted as iconst_m1; ixor
+    int max = d.max;
+    for (int i = 0; i < ir->count; i++) {
+        if (ir->code[i].kind == IR_BIT_NOT && d.depth[i] >= 0 && d.depth[i] + 1 > max) {
+            max = d.depth[i] + 1;
+        }
+    }
+
+    stack_depths_free(&d);
+    cfg_free(&cfg);
+    return max;
+}
+
+// Optimize and emit one function from its lowered IR, which is freed.
+// dot, if not NULL, receives the function's CFG (--dump-cfg); refs receives
+// the user functions it calls and the globals it reads or writes.
+static void generate_function(FILE *out, FILE *dot, AST *func, IRList *lowered, NameSet *refs,
+                              const char *classname) {
     if (!func || func->kind != AST_FUNC) return;
 
-    IRList ir;
-    generate_ir_from_ast(func, &ir);
+    IRList ir = *lowered;
+
+    opt_run(&ir, func);
+
+    for (int i = 0; i < ir.count; i++) {
+        IRInstruction *p = &ir.code[i];
+        if (p->kind == IR_CALL && p->callee && !is_stdlib_function(p->callee->name)) {
+            nameset_add(refs, p->callee->name);
+        } else if (p->kind == IR_LOAD_GLOBAL || p->kind == IR_STORE_GLOBAL) {
+            nameset_add(refs, p->s);
+        } else if (p->kind == IR_PUSH_STRING && !(p->flags & IRF_COPY)) {
+            // Literals keep their quotes, so they never clash with a name
+            nameset_add(refs, p->s);
+        }
+    }
 
     //ir_print(&ir, stdout);
 
+    if (dot) {
+        CFG cfg;
+        cfg_build(&cfg, &ir);
+        cfg_dump_dot(dot, &cfg, func->func.name);
+        cfg_free(&cfg);
+    }
+
+    // Exactly the slots the code uses; parameters occupy theirs even when unused
+    int locals = ir_local_count(&ir);
+    if (locals < ir_param_slots(func)) locals = ir_param_slots(func);
+
+    int stack = max_stack_depth(&ir, func->func.name);
+
     emit_method_header(out, classname, func->func.name, 
-                      func->func.return_type, func->func.params);
+                      func->func.return_type, func->func.params, stack, locals);
     
     emit_java_from_ir(out, classname, &ir);
     
     if (func->func.return_type && func->func.return_type->kind == TY_VOID) {
-        if (!ir.tail || ir.tail->kind != IR_RETURN_VOID) {
+        if (ir.count == 0 || ir.code[ir.count - 1].kind != IR_RETURN_VOID) {
             fprintf(out, "    return\n");
         }
     }
     
     emit_method_footer(out);
+
+    irlist_free(&ir);
 }
 
-static void emit_functions_from_ast(FILE *out, AST *node, const char *classname) {
+// One function's worth of work for the code generator. Each job renders
+// into its own memory buffer, on -j threads; buffers of the functions that
+// are kept are written out in source order.
+typedef struct {
+    AST *func;
+    IRList ir;
+    NameSet refs;
+    char *buf;
+    size_t len;
+    char *dot;                  // CFG dump, with --dump-cfg
+    size_t dot_len;
+} FunctionJob;
+
+typedef struct {
+    FunctionJob *jobs;
+    int count;
+    int capacity;
+    int next;                   // next job to hand out, guarded by lock
+    pthread_mutex_t lock;
+    const char *classname;
+} FunctionQueue;
+
+static void collect_functions(FunctionQueue *q, AST *node) {
     if (!node) return;
 
     for (AST *n = node; n != NULL; n = n->next) {
         if (n->kind == AST_FUNC) {
-            generate_function(out, n, classname);
+            if (q->count == q->capacity) {
+                q->capacity = q->capacity ? q->capacity * 2 : 16;
+                q->jobs = realloc(q->jobs, q->capacity * sizeof(FunctionJob));
+            }
+            memset(&q->jobs[q->count], 0, sizeof(FunctionJob));
+            q->jobs[q->count].func = n;
+            q->count++;
         } else if (n->kind == AST_BLOCK) {
             for (int i = 0; i < n->block.count; i++) {
-                emit_functions_from_ast(out, n->block.statements[i], classname);
+                collect_functions(q, n->block.statements[i]);
             }
         }
     }
 }
 
+static void *codegen_worker(void *arg) {
+    FunctionQueue *q = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&q->lock);
+        int idx = q->next++;
+        pthread_mutex_unlock(&q->lock);
+
+        if (idx >= q->count) break;
+
+        FunctionJob *job = &q->jobs[idx];
+        FILE *buf = open_memstream(&job->buf, &job->len);
+        if (!buf) {
+            fprintf(stderr, "Code generation error: cannot buffer function %s\n", job->func->func.name);
+            continue;
+        }
+        FILE *dot = dump_cfg ? open_memstream(&job->dot, &job->dot_len) : NULL;
+        generate_function(buf, dot, job->func, &job->ir, &job->refs, q->classname);
+        fclose(buf);
+        if (dot) fclose(dot);
+    }
+
+    return NULL;
+}
+
+// Lower, inline, optimize and render every function into its job's buffer
+static void compile_functions(FunctionQueue *q) {
+    // Every function is lowered before any is optimized, so the inliner
+    // can copy callees into callers
+    AST **funcs = malloc((q->count ? q->count : 1) * sizeof(AST *));
+    IRList *irs = malloc((q->count ? q->count : 1) * sizeof(IRList));
+    for (int i = 0; i < q->count; i++) {
+        funcs[i] = q->jobs[i].func;
+        generate_ir_from_ast(funcs[i], &irs[i]);
+    }
+    inline_functions(funcs, irs, q->count);
+    for (int i = 0; i < q->count; i++) {
+        q->jobs[i].ir = irs[i];
+        for (int k = 0; k < irs[i].count; k++) {
+            IRInstruction *p = &irs[i].code[k];
+            if (p->kind == IR_PUSH_STRING && !(p->flags & IRF_COPY)) nameset_add(&strings, p->s);
+        }
+    }
+    free(funcs);
+    free(irs);
+
+    pthread_mutex_init(&q->lock, NULL);
+
+    int workers = num_jobs < q->count ? num_jobs : q->count;
+    pthread_t *threads = malloc((workers > 0 ? workers : 1) * sizeof(pthread_t));
+
+    int started = 0;
+    for (int i = 0; workers > 1 && i < workers; i++) {
+        if (pthread_create(&threads[started], NULL, codegen_worker, q) == 0) {
+            started++;
+        }
+    }
+    // With -j 1, or if no thread could be started, do the work on this one
+    if (started == 0) {
+        codegen_worker(q);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&q->lock);
+    free(threads);
+}
+
+// Mark everything main can reach through calls and global accesses. A
+// program without main keeps all of its functions and globals.
+static void find_live(FunctionQueue *q) {
+    live.count = 0;
+    prune_dead = false;
+
+    for (int i = 0; i < q->count; i++) {
+        if (strcmp(q->jobs[i].func->func.name, "main") == 0) prune_dead = true;
+    }
+    if (!prune_dead) return;
+
+    nameset_add(&live, "main");
+    // live grows while it is scanned; every name is expanded exactly once
+    for (int n = 0; n < live.count; n++) {
+        for (int i = 0; i < q->count; i++) {
+            FunctionJob *job = &q->jobs[i];
+            if (strcmp(job->func->func.name, live.names[n]) != 0) continue;
+            for (int r = 0; r < job->refs.count; r++) nameset_add(&live, job->refs.names[r]);
+        }
+    }
+}
+
+// Write the kept functions' buffers in source order and free every job
+static void emit_functions(FILE *out, FILE *dot, FunctionQueue *q) {
+    for (int i = 0; i < q->count; i++) {
+        FunctionJob *job = &q->jobs[i];
+        bool keep = is_live(job->func->func.name);
+
+        if (keep && job->buf) fwrite(job->buf, 1, job->len, out);
+        if (keep && job->dot && dot) fwrite(job->dot, 1, job->dot_len, dot);
+        if (!keep && dead_code_report) {
+            fprintf(stderr, "Removed unreachable function %s\n", job->func->func.name);
+        }
+
+        free(job->buf);
+        free(job->dot);
+        free(job->refs.names);
+    }
+    free(q->jobs);
+}
+
 static void emit_globals_from_ast(FILE *out, AST *node) {
     if (!node) return;
     
     for (AST *n = node; n != NULL; n = n->next) {
         if (n->kind == AST_DECL) {
-            emit_global_field(out, n->decl.name, n->decl.decl_type);
+            if (is_live(n->decl.name)) {
+                emit_global_field(out, n->decl.name, n->decl.decl_type);
+            } else if (dead_code_report) {
+                fprintf(stderr, "Removed unused global %s\n", n->decl.name);
+            }
         } else if (n->kind == AST_BLOCK) {
             for (int i = 0; i < n->block.count; i++) {
                 emit_globals_from_ast(out, n->block.statements[i]);
@@ -631,13 +1000,50 @@ void generate_code(AST *program) {
     
     char *output_filename = getOutputFileName();
     char *classname = get_classname_from_output(output_filename);
+
+    // Functions are compiled first so that what they use is known before
+    // the fields and <clinit> are written
+    FunctionQueue q = { .classname = classname };
+    collect_functions(&q, program);
+    compile_functions(&q);
+    if (opt_level >= 1) find_live(&q);
     
     emit_class_header(outputFile, classname);
     emit_globals_from_ast(outputFile, program);
+    for (int k = 0; k < strings.count; k++) {
+        if (is_live(strings.names[k])) fprintf(outputFile, ".field private static final str$%d [C\n", k);
+    }
     emit_static_initializer(outputFile, classname, program);
-    emit_functions_from_ast(outputFile, program, classname);
+    FILE *dot = NULL;
+    if (dump_cfg) {
+        char *dot_filename = malloc(strlen(classname) + 5);
+        sprintf(dot_filename, "%s.dot", classname);
+        dot = fopen(dot_filename, "w");
+        if (!dot) {
+            fprintf(stderr, "Code generation error: cannot open %s\n", dot_filename);
+        } else {
+            fprintf(dot, "digraph cfg {\n");
+        }
+        free(dot_filename);
+    }
+
+    emit_functions(outputFile, dot, &q);
+
+    if (dot) {
+        fprintf(dot, "}\n");
+        fclose(dot);
+    }
+
+    if (pass_stats) {
+        opt_report(stderr);
+    }
     emit_init_method(outputFile, classname);
     emit_java_main(outputFile, classname);
     
+    free(live.names);
+    live = (NameSet){ 0 };
+    free(strings.names);
+    strings = (NameSet){ 0 };
+    prune_dead = false;
     free(classname);
 }
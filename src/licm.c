@@ -0,0 +1,264 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Loop-invariant code motion. Within each loop block the operand stack is
+// replayed to find expression trees (contiguous runs of instructions that
+// together push one value) built only from constants, locals the loop
+// never writes and globals it never stores, through operations that have
+// no side effects and cannot throw. Each maximal such tree is computed once
+// in a preheader into a fresh local and replaced by a load of it:
+//
+//     pre:    LOAD n; LOAD m; MUL; STORE t
+//     header: ...     LOAD t      ...
+//
+// Hoisted code runs even when the loop body would not have, so anything
+// that can throw (integer division, array access) or allocate stays put;
+// everything else is harmless to run once more than needed. Loops that call
+// a user function keep their global loads, since the callee may store them.
+//
+// Inner loops go first, so an invariant of an inner loop that is also
+// invariant in the outer one moves out again from the inner preheader.
+
+// A value on the replayed stack: the instructions [start, root] push it
+typedef struct {
+    int start;
+    int root;
+    bool invariant;
+} Operand;
+
+typedef struct {
+    int start;
+    int root;
+    int local;              // index of the tree computing the same value first
+} Tree;
+
+// What one loop writes
+typedef struct {
+    char *written;          // local slots stored or incremented in the loop
+    const char **stored;    // globals stored in the loop
+    int nstored;
+    bool calls;             // calls a user function
+} LoopEffects;
+
+static bool global_stored(LoopEffects *fx, const char *name) {
+    for (int k = 0; k < fx->nstored; k++) {
+        if (strcmp(fx->stored[k], name) == 0) return true;
+    }
+    return false;
+}
+
+// True if p computes the same value on every iteration, given invariant
+// operands, and can be run speculatively
+static bool invariant_op(IRInstruction *p, LoopEffects *fx) {
+    switch (p->kind) {
+        case IR_PUSH_INT: case IR_PUSH_FLOAT:
+            return true;
+        case IR_LOAD_LOCAL:
+            return !fx->written[p->i];
+        case IR_LOAD_GLOBAL:
+            return p->s && !fx->calls && !global_stored(fx, p->s);
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_NEG:
+        case IR_BIT_AND: case IR_BIT_OR: case IR_BIT_XOR: case IR_BIT_NOT: case IR_SHL: case IR_SHR:
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_CAST_I2F: case IR_CAST_F2I:
+            return true;
+        case IR_DIV: case IR_MOD:
+            return p->type == IRT_FLOAT;        // idiv and irem can throw
+        default:
+            return false;
+    }
+}
+
+// Type of the value a tree rooted at p leaves on the stack
+static IRType result_type(IRInstruction *p) {
+    switch (p->kind) {
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            return IRT_INT;
+        default:
+            return p->type;
+    }
+}
+
+// Worth a local: a getstatic, or an operation on something loaded
+static bool worth_hoisting(IRList *ir, int start, int root) {
+    if (ir->code[root].kind == IR_LOAD_GLOBAL) return true;
+    if (root == start) return false;
+    for (int i = start; i <= root; i++) {
+        IRKind k = ir->code[i].kind;
+        if (k == IR_LOAD_LOCAL || k == IR_LOAD_GLOBAL) return true;
+    }
+    return false;
+}
+
+static bool same_instruction(IRInstruction *a, IRInstruction *b) {
+    if (a->kind != b->kind || a->type != b->type || a->flags != b->flags || a->i != b->i) return false;
+    switch (a->kind) {
+        case IR_PUSH_FLOAT:
+            return memcmp(&a->f, &b->f, sizeof a->f) == 0;
+        case IR_LOAD_GLOBAL:
+            return strcmp(a->s, b->s) == 0;
+        default:
+            return true;
+    }
+}
+
+static bool same_tree(IRList *ir, Tree *a, Tree *b) {
+    if (a->root - a->start != b->root - b->start) return false;
+    for (int k = 0; k <= a->root - a->start; k++) {
+        if (!same_instruction(&ir->code[a->start + k], &ir->code[b->start + k])) return false;
+    }
+    return true;
+}
+
+// Maximal invariant trees of block b
+static void find_trees(IRList *ir, BasicBlock *bb, LoopEffects *fx, Tree **trees, int *count) {
+    int cap = 16, depth = 0;
+    Operand *stack = malloc(cap * sizeof(Operand));
+
+    for (int i = bb->start; i < bb->end; i++) {
+        IRInstruction *p = &ir->code[i];
+        int pops, pushes;
+        ir_stack_effect(p, &pops, &pushes);
+
+        // Operands from earlier blocks are not ours to move
+        int have = depth < pops ? depth : pops;
+        Operand *ops = &stack[depth - have];
+        bool inv = have == pops && pushes == 1 && pops <= 2 && invariant_op(p, fx);
+        for (int k = 0; k < have && inv; k++) {
+            int next_start = k + 1 < have ? ops[k + 1].start : i;
+            inv = ops[k].invariant && ops[k].root + 1 == next_start;
+        }
+
+        Operand result = { i, i, false };
+        if (inv) {
+            result.start = have ? ops[0].start : i;
+            result.invariant = true;
+        } else {
+            for (int k = 0; k < have; k++) {
+                if (!ops[k].invariant || !worth_hoisting(ir, ops[k].start, ops[k].root)) continue;
+                *trees = realloc(*trees, (*count + 1) * sizeof(Tree));
+                (*trees)[(*count)++] = (Tree){ ops[k].start, ops[k].root, -1 };
+            }
+        }
+
+        depth -= have;
+        if (depth + pushes > cap) {
+            cap = (depth + pushes) * 2;
+            stack = realloc(stack, cap * sizeof(Operand));
+        }
+        for (int k = 0; k < pushes; k++) stack[depth++] = result;
+    }
+
+    free(stack);
+}
+
+// Hoist the invariant trees of one loop into a new preheader
+static int hoist_loop(IRList *ir, CFG *cfg, Loop *loop, int *next_slot) {
+    int hstart = cfg->blocks[loop->header].start;
+
+    if (!cfg_loop_has_preheader_slot(cfg, loop)) return 0;
+
+    LoopEffects fx = { calloc(*next_slot ? *next_slot : 1, 1), NULL, 0, false };
+    for (int b = 0; b < cfg->count; b++) {
+        if (!bitset_test(&loop->body, b)) continue;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            IRInstruction *p = &ir->code[i];
+            if (p->kind == IR_STORE_LOCAL || p->kind == IR_INC) {
+                fx.written[p->i] = 1;
+            } else if (p->kind == IR_STORE_GLOBAL && p->s) {
+                fx.stored = realloc(fx.stored, (fx.nstored + 1) * sizeof(const char *));
+                fx.stored[fx.nstored++] = p->s;
+            } else if (p->kind == IR_CALL && (!p->callee || !is_stdlib_function(p->callee->name))) {
+                fx.calls = true;
+            }
+        }
+    }
+
+    Tree *trees = NULL;
+    int count = 0;
+    for (int b = 0; b < cfg->count; b++) {
+        if (bitset_test(&loop->body, b)) find_trees(ir, &cfg->blocks[b], &fx, &trees, &count);
+    }
+    free(fx.written);
+    free(fx.stored);
+    if (count == 0) return 0;
+
+    // Tree starting at each instruction, -1 if none. A repeated tree
+    // shares the local of its first occurrence.
+    int *tree_at = malloc(ir->count * sizeof(int));
+    for (int i = 0; i < ir->count; i++) tree_at[i] = -1;
+    int nlocals = 0;
+    for (int k = 0; k < count; k++) {
+        tree_at[trees[k].start] = k;
+        for (int j = 0; j < k && trees[k].local < 0; j++) {
+            if (same_tree(ir, &trees[j], &trees[k])) trees[k].local = trees[j].local;
+        }
+        if (trees[k].local < 0) trees[k].local = nlocals++;
+    }
+
+    // Jumps into the loop from outside go through the preheader
+    int pre = ir_new_label(ir);
+    cfg_retarget_loop_entries(cfg, loop, pre);
+
+    int base = *next_slot;
+    *next_slot += nlocals;
+
+    IRList out;
+    irlist_init(&out);
+    for (int i = 0; i < ir->count; i++) {
+        if (i == hstart) {
+            ir_emit(&out, IR_LABEL, IRT_NONE, pre);
+            for (int k = 0, computed = 0; k < count; k++) {
+                // Each local is computed by the first tree that uses it
+                if (trees[k].local < computed) continue;
+                computed++;
+                for (int j = trees[k].start; j <= trees[k].root; j++) {
+                    ir_append(&out, &ir->code[j]);
+                }
+                ir_emit(&out, IR_STORE_LOCAL, result_type(&ir->code[trees[k].root]), base + trees[k].local);
+            }
+        }
+
+        int k = tree_at[i];
+        if (k >= 0) {
+            ir_emit(&out, IR_LOAD_LOCAL, result_type(&ir->code[trees[k].root]), base + trees[k].local);
+            i = trees[k].root;
+            continue;
+        }
+        ir_append(&out, &ir->code[i]);
+    }
+
+    free(ir->code);
+    ir->code = out.code;
+    ir->count = out.count;
+    ir->capacity = out.capacity;
+    ir_resolve_labels(ir);
+
+    free(tree_at);
+    free(trees);
+    return count;
+}
+
+int pass_licm(IRList *ir, AST *func) {
+    int changed = 0;
+    int next_slot = ir_local_count(ir);
+    if (next_slot < ir_param_slots(func)) next_slot = ir_param_slots(func);
+
+    // One loop per round; the CFG is rebuilt after every change
+    for (int round = 0; round < 64; round++) {
+        CFG cfg;
+        cfg_build(&cfg, ir);
+
+        int hoisted = 0;
+        for (int l = cfg.loop_count - 1; l >= 0 && hoisted == 0; l--) {
+            hoisted = hoist_loop(ir, &cfg, &cfg.loops[l], &next_slot);
+        }
+        cfg_free(&cfg);
+
+        if (hoisted == 0) break;
+        changed += hoisted;
+    }
+    return changed;
+}
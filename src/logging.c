@@ -1,8 +1,25 @@
 #include "logging.h"
+#include "global.h"
+#include "opt.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
 
 void logUsage(){
-    fprintf(stderr, "\n\n Usage: \n mycc -mode infile \n \nmode: integer 1-5 \ninfile: path to file to compile (Not used for mode 1)\n");
+    fprintf(stderr, "\n\n Usage: \n mycc -mode [options] infile \n \nmode: integer 1-5 \ninfile: path to file to compile (Not used for mode 1)\n"
+                    "\noptions:\n -j N: generate code for functions on N threads (modes 5-6)\n"
+                    " -O0, -O1, -O2: optimization level (default -O0)\n"
+                    " --passes=a,b,c: run exactly these IR passes, in order (overrides -O)\n"
+                    " --pass-stats: print time and instructions removed/changed per pass\n"
+                    " --dump-cfg: write the control-flow graph of each function to <class>.dot (modes 5-6)\n"
+                    " --inline-limit=N: inline calls to functions of at most N instructions (0 disables)\n"
+                    " --inline-caller-limit=N: stop inlining into a function once it has N instructions\n"
+                    " --inline-report: list every call site the inliner considered\n"
+                    " --unroll-budget=N: unroll counted for loops into at most N instructions (0 disables)\n"
+                    " --unroll=N: body copies per test when a loop is only partially unrolled (1 disables)\n"
+                    " --dead-code-report: list functions and globals removed because main never reaches them\n");
 }
 
 void logCompilerInfo(){
@@ -22,6 +39,18 @@ void logBadInput(char *functionName){
     fprintf(stderr, "Bad input to function %s\n", functionName);
 }
 
+//Parse a whole option argument as a decimal int; 0 on anything else
+static int parseInt(const char *s, int *value){
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if(end == s || *end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX){
+        return 0;
+    }
+    *value = (int)v;
+    return 1;
+}
+
 int handleInputs(char *argv[], int argc){
     //No flags/arguments
     int mode;
@@ -32,7 +61,61 @@ int handleInputs(char *argv[], int argc){
 
     sscanf(argv[1], "-%d", &mode);
 
-    if(argc == 2){
+    //Options may appear before or after the infile
+    for(int i = 2; i < argc; i++){
+        if(strncmp(argv[i], "-j", 2) == 0){
+            const char *count = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : NULL);
+            if(!count || !parseInt(count, &num_jobs) || num_jobs < 1){
+                fprintf(stderr, "Option -j requires a positive thread count.\n");
+                return -1;
+            }
+        } else if(strncmp(argv[i], "-O", 2) == 0){
+            if(!parseInt(argv[i] + 2, &opt_level) || opt_level < 0 || opt_level > 2){
+                fprintf(stderr, "Optimization level must be -O0, -O1 or -O2.\n");
+                return -1;
+            }
+        } else if(strncmp(argv[i], "--passes=", 9) == 0){
+            opt_passes = argv[i] + 9;
+            if(!opt_pipeline_valid(opt_passes)){
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--pass-stats") == 0){
+            pass_stats = 1;
+        } else if(strcmp(argv[i], "--dump-cfg") == 0){
+            dump_cfg = 1;
+        } else if(strncmp(argv[i], "--inline-limit=", 15) == 0){
+            if(!parseInt(argv[i] + 15, &inline_limit) || inline_limit < 0){
+                fprintf(stderr, "Option --inline-limit requires a non-negative size.\n");
+                return -1;
+            }
+        } else if(strncmp(argv[i], "--inline-caller-limit=", 22) == 0){
+            if(!parseInt(argv[i] + 22, &inline_caller_limit) || inline_caller_limit < 0){
+                fprintf(stderr, "Option --inline-caller-limit requires a non-negative size.\n");
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--inline-report") == 0){
+            inline_report = 1;
+        } else if(strncmp(argv[i], "--unroll-budget=", 16) == 0){
+            if(!parseInt(argv[i] + 16, &unroll_budget) || unroll_budget < 0){
+                fprintf(stderr, "Option --unroll-budget requires a non-negative size.\n");
+                return -1;
+            }
+        } else if(strncmp(argv[i], "--unroll=", 9) == 0){
+            if(!parseInt(argv[i] + 9, &unroll_factor) || unroll_factor < 1){
+                fprintf(stderr, "Option --unroll requires a positive factor.\n");
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--dead-code-report") == 0){
+            dead_code_report = 1;
+        } else if(argv[i][0] == '-'){
+            fprintf(stderr, "Unknown option %s.\n", argv[i]);
+            return -1;
+        } else {
+            input_file = argv[i];
+        }
+    }
+
+    if(!input_file){
         //Check mode is 1 else error
         if(mode == 1){
             return 1;
@@ -45,4 +128,3 @@ int handleInputs(char *argv[], int argc){
 
     return mode;
 }
-
@@ -0,0 +1,382 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Local value numbering. Each basic block is interpreted with a value
+// number for every stack value; a computation whose operator and operand
+// value numbers were seen before in the block yields the same value. When
+// a repeated computation is worth it, its first result is saved in a fresh
+// local slot (DUP; STORE_LOCAL) and the later ones become a LOAD_LOCAL.
+//
+// Loads are numbered against what can change them: a local slot by the
+// stores to it, globals by global stores and calls, array elements by array
+// stores and calls.
+
+// Blocks longer than this are left alone to bound the quadratic lookup
+#define LVN_MAX_BLOCK 2000
+
+// An expression seen in the block
+typedef struct {
+    unsigned char kind;
+    unsigned char type;
+    unsigned char flags;
+    int i;
+    IRInstruction *instr;   // for the name of global loads and float bits
+    int a, b;               // operand value numbers, -1 if unused
+    int epoch;              // version of the memory or slot a load reads
+    int vn;
+    int first;              // instruction that first computed it
+    int weight;             // cost of the first computation's tree
+    int *reuses;            // later occurrences: start and end index pairs
+    int nreuses;
+    int tmp;                // slot holding the value once chosen, else -1
+} Expr;
+
+// A value on the simulated stack
+typedef struct {
+    int vn;
+    int start;              // first instruction of the tree that computed it, -1 if none
+    int end;                // instruction that pushed it
+    int weight;
+} StackValue;
+
+typedef struct {
+    Expr *exprs;
+    int nexprs;
+    int next_vn;
+    StackValue *stack;
+    int depth;
+    int stack_capacity;
+    int *local_epoch;
+    int nlocals;
+    int stores;
+    int global_epoch;
+    int array_epoch;
+} LVN;
+
+// Operations whose result depends only on their operands and the loads
+// they read; these can be reused. Division and array loads can throw, but
+// not the second time if the first one did not.
+static bool is_value_op(IRInstruction *p) {
+    switch (p->kind) {
+        case IR_PUSH_INT: case IR_PUSH_FLOAT:
+        case IR_LOAD_LOCAL: case IR_LOAD_GLOBAL: case IR_ARRAY_LOAD:
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_BIT_AND: case IR_BIT_OR: case IR_BIT_XOR: case IR_SHL: case IR_SHR:
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_NEG: case IR_BIT_NOT: case IR_CAST_I2F: case IR_CAST_F2I:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Rough relative cost of executing an instruction
+static int instr_weight(IRInstruction *p) {
+    switch (p->kind) {
+        case IR_LOAD_GLOBAL: case IR_ARRAY_LOAD:
+        case IR_MUL: case IR_DIV: case IR_MOD:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// Type of the value an instruction pushes
+static IRType result_type(IRInstruction *p) {
+    switch (p->kind) {
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_CAST_F2I:
+            return IRT_INT;
+        case IR_CAST_I2F:
+            return IRT_FLOAT;
+        default:
+            return p->type;
+    }
+}
+
+static bool same_expr(Expr *e, IRInstruction *p, int a, int b, int epoch) {
+    if (e->kind != p->kind || e->type != p->type || e->flags != p->flags ||
+        e->a != a || e->b != b || e->epoch != epoch) return false;
+
+    switch (p->kind) {
+        case IR_LOAD_GLOBAL:
+            return strcmp(e->instr->s, p->s) == 0;
+        case IR_PUSH_FLOAT:
+            return memcmp(&e->instr->f, &p->f, sizeof(float)) == 0;
+        default:
+            return e->i == p->i;
+    }
+}
+
+// Room for one more value on the simulated stack
+static void grow_stack(LVN *s) {
+    if (s->depth == s->stack_capacity) {
+        s->stack_capacity = s->stack_capacity ? s->stack_capacity * 2 : 16;
+        s->stack = realloc(s->stack, s->stack_capacity * sizeof(StackValue));
+    }
+}
+
+static void push_value(LVN *s, int vn, int start, int end, int weight) {
+    grow_stack(s);
+    s->stack[s->depth].vn = vn;
+    s->stack[s->depth].start = start;
+    s->stack[s->depth].end = end;
+    s->stack[s->depth].weight = weight;
+    s->depth++;
+}
+
+// First instruction of the tree that computes instruction i's result: the
+// operands' trees must follow each other directly and end right before i,
+// so that the whole range can be replaced. -1 if they do not.
+static int tree_start(StackValue *ops, int pops, int i) {
+    for (int k = 0; k < pops; k++) {
+        int next = k + 1 < pops ? ops[k + 1].start : i;
+        if (ops[k].start < 0 || ops[k].end + 1 != next) return -1;
+    }
+    return pops > 0 ? ops[0].start : i;
+}
+
+static void number_block(LVN *s, IRList *ir, int start, int end) {
+    for (int i = start; i < end; i++) {
+        IRInstruction *p = &ir->code[i];
+        int pops, pushes;
+        ir_stack_effect(p, &pops, &pushes);
+
+        // Values left by earlier blocks get fresh numbers and no tree
+        while (s->depth < pops) {
+            grow_stack(s);
+            memmove(&s->stack[1], &s->stack[0], s->depth * sizeof(StackValue));
+            s->stack[0].vn = s->next_vn++;
+            s->stack[0].start = -1;
+            s->stack[0].end = -1;
+            s->stack[0].weight = 0;
+            s->depth++;
+        }
+        StackValue *ops = &s->stack[s->depth - pops];
+
+        if (is_value_op(p) && pushes == 1) {
+            int a = pops >= 1 ? ops[0].vn : -1;
+            int b = pops >= 2 ? ops[1].vn : -1;
+            int epoch = 0;
+            if (p->kind == IR_LOAD_LOCAL) epoch = p->i < s->nlocals ? s->local_epoch[p->i] : 0;
+            if (p->kind == IR_LOAD_GLOBAL) epoch = s->global_epoch;
+            if (p->kind == IR_ARRAY_LOAD) epoch = s->array_epoch;
+
+            int tree = tree_start(ops, pops, i);
+            int weight = instr_weight(p);
+            for (int k = 0; k < pops; k++) weight += ops[k].weight;
+
+            Expr *found = NULL;
+            for (int e = 0; e < s->nexprs; e++) {
+                if (same_expr(&s->exprs[e], p, a, b, epoch)) {
+                    found = &s->exprs[e];
+                    break;
+                }
+            }
+
+            int vn;
+            if (found) {
+                vn = found->vn;
+                if (tree >= 0) {
+                    found->reuses = realloc(found->reuses, (found->nreuses + 1) * 2 * sizeof(int));
+                    found->reuses[found->nreuses * 2] = tree;
+                    found->reuses[found->nreuses * 2 + 1] = i;
+                    found->nreuses++;
+                }
+            } else {
+                vn = s->next_vn++;
+                s->exprs = realloc(s->exprs, (s->nexprs + 1) * sizeof(Expr));
+                Expr *e = &s->exprs[s->nexprs++];
+                e->kind = p->kind;
+                e->type = p->type;
+                e->flags = p->flags;
+                e->i = p->i;
+                e->instr = p;
+                e->a = a;
+                e->b = b;
+                e->epoch = epoch;
+                e->vn = vn;
+                e->first = i;
+                e->weight = weight;
+                e->reuses = NULL;
+                e->nreuses = 0;
+                e->tmp = -1;
+            }
+
+            s->depth -= pops;
+            push_value(s, vn, tree, i, weight);
+            continue;
+        }
+
+        switch (p->kind) {
+            case IR_STORE_LOCAL:
+            case IR_INC:
+                if (p->i < s->nlocals) s->local_epoch[p->i] = ++s->stores;
+                break;
+            case IR_STORE_GLOBAL:
+                s->global_epoch++;
+                break;
+            case IR_ARRAY_STORE:
+            case IR_ARRAY_FILL:
+            case IR_ARRAY_COPY:
+                s->array_epoch++;
+                break;
+            case IR_CALL:
+                s->global_epoch++;
+                s->array_epoch++;
+                break;
+            default:
+                break;
+        }
+
+        if (p->kind == IR_DUP && pops == 1) {
+            // Both copies are the same value, but neither is a tree any more
+            int vn = ops[0].vn;
+            s->depth -= 1;
+            push_value(s, vn, -1, i, 0);
+            push_value(s, vn, -1, i, 0);
+            continue;
+        }
+
+        s->depth -= pops;
+        for (int k = 0; k < pushes; k++) push_value(s, s->next_vn++, -1, i, 0);
+    }
+}
+
+static int compare_weight(const void *x, const void *y) {
+    const Expr *a = *(const Expr **)x, *b = *(const Expr **)y;
+    if (a->weight != b->weight) return b->weight - a->weight;
+    return a->first - b->first;
+}
+
+// Pick the repeated computations worth keeping in a temporary. Larger
+// expressions go first so that a reused a[i*n+j] is not split up by
+// reusing i*n inside it.
+static int choose_reuses(LVN *s, int *next_slot, int *save_at, int *replace_end,
+                         int *replace_slot, IRType *slot_type, char *covered) {
+    Expr **order = malloc((s->nexprs ? s->nexprs : 1) * sizeof(Expr *));
+    int n = 0, changed = 0;
+
+    for (int e = 0; e < s->nexprs; e++) {
+        if (s->exprs[e].nreuses > 0) order[n++] = &s->exprs[e];
+    }
+    qsort(order, n, sizeof(Expr *), compare_weight);
+
+    for (int k = 0; k < n; k++) {
+        Expr *e = order[k];
+        if (covered[e->first]) continue;
+
+        // Keep the occurrences that do not overlap a range already replaced
+        int kept = 0;
+        for (int r = 0; r < e->nreuses; r++) {
+            int start = e->reuses[r * 2], end = e->reuses[r * 2 + 1];
+            bool free_range = true;
+            for (int i = start; i <= end && free_range; i++) {
+                if (covered[i] || save_at[i] >= 0) free_range = false;
+            }
+            if (free_range) {
+                e->reuses[kept * 2] = start;
+                e->reuses[kept * 2 + 1] = end;
+                kept++;
+            }
+        }
+
+        // Each reuse saves its computation but costs a load; saving the
+        // value costs a dup and a store
+        if (kept * (e->weight - 1) <= 2) continue;
+
+        int slot = (*next_slot)++;
+        save_at[e->first] = slot;
+        slot_type[e->first] = result_type(e->instr);
+        for (int r = 0; r < kept; r++) {
+            int start = e->reuses[r * 2], end = e->reuses[r * 2 + 1];
+            memset(&covered[start], 1, end - start + 1);
+            replace_end[start] = end;
+            replace_slot[start] = slot;
+            slot_type[start] = slot_type[e->first];
+        }
+        changed += kept;
+    }
+
+    free(order);
+    return changed;
+}
+
+int pass_lvn(IRList *ir, AST *func) {
+    int n = ir->count;
+    int nlocals = ir_local_count(ir);
+    int next_slot = nlocals > ir_param_slots(func) ? nlocals : ir_param_slots(func);
+    int changed = 0;
+
+    if (n == 0) return 0;
+
+    // Per instruction: the slot its result is saved in, or the slot that
+    // replaces the range starting there, and the type of that slot
+    int *save_at = malloc(n * sizeof(int));
+    int *replace_end = malloc(n * sizeof(int));
+    int *replace_slot = malloc(n * sizeof(int));
+    IRType *slot_type = malloc(n * sizeof(IRType));
+    char *covered = calloc(n, 1);
+    for (int i = 0; i < n; i++) save_at[i] = replace_slot[i] = -1;
+
+    CFG cfg;
+    cfg_build(&cfg, ir);
+
+    LVN s;
+    memset(&s, 0, sizeof(s));
+    s.nlocals = nlocals;
+    s.local_epoch = calloc(nlocals ? nlocals : 1, sizeof(int));
+
+    for (int b = 0; b < cfg.count; b++) {
+        BasicBlock *bb = &cfg.blocks[b];
+        int len = bb->end - bb->start;
+        if (len < 2 || len > LVN_MAX_BLOCK) continue;
+
+        // The stack grows as values are pulled from earlier blocks and pushed
+        s.depth = 0;
+        s.nexprs = 0;
+        number_block(&s, ir, bb->start, bb->end);
+        changed += choose_reuses(&s, &next_slot, save_at, replace_end, replace_slot, slot_type, covered);
+
+        for (int e = 0; e < s.nexprs; e++) free(s.exprs[e].reuses);
+    }
+
+    if (changed > 0) {
+        IRList out;
+        irlist_init(&out);
+        out.label_count = ir->label_count;
+
+        for (int i = 0; i < n; i++) {
+            if (replace_slot[i] >= 0) {
+                ir_emit(&out, IR_LOAD_LOCAL, slot_type[i], replace_slot[i]);
+                i = replace_end[i];
+                continue;
+            }
+            ir_append(&out, &ir->code[i]);
+            if (save_at[i] >= 0) {
+                ir_emit(&out, IR_DUP, IRT_NONE, 0);
+                ir_emit(&out, IR_STORE_LOCAL, slot_type[i], save_at[i]);
+            }
+        }
+
+        free(ir->code);
+        ir->code = out.code;
+        ir->count = out.count;
+        ir->capacity = out.capacity;
+        ir_resolve_labels(ir);
+        free(out.label_pos);
+    }
+
+    free(s.exprs);
+    free(s.stack);
+    free(s.local_epoch);
+    cfg_free(&cfg);
+    free(save_at);
+    free(replace_end);
+    free(replace_slot);
+    free(slot_type);
+    free(covered);
+    return changed;
+}
@@ -7,6 +7,7 @@
 #include "typecheck.h"
 #include "stack.h"
 #include "jbcgen.h"
+#include "global.h"
 
 extern FILE *outputFile;
 
@@ -17,6 +18,19 @@ int yyparse(void);
 int mode;
 AST *root_ast;
 
+char *input_file = NULL;
+int num_jobs = 1;
+int opt_level = 0;
+char *opt_passes = NULL;
+int pass_stats = 0;
+int dump_cfg = 0;
+int inline_limit = -1;
+int inline_caller_limit = 2000;
+int inline_report = 0;
+int unroll_budget = -1;
+int unroll_factor = 4;
+int dead_code_report = 0;
+
 int main(int argc, char *argv[]){
     switch(mode = handleInputs(argv, argc)){
         case 1:
@@ -24,7 +38,7 @@ int main(int argc, char *argv[]){
             break;
 
         case 2:
-            if(pushFile(argv[2]) != 0){
+            if(pushFile(input_file) != 0){
                return -1;
             }
 
@@ -32,7 +46,7 @@ int main(int argc, char *argv[]){
             break;
 
         case 3:
-            if(pushFile(argv[2]) != 0){
+            if(pushFile(input_file) != 0){
                return -1;
             }
 
@@ -45,7 +59,7 @@ int main(int argc, char *argv[]){
             break;
 
         case 4:
-            if(pushFile(argv[2]) != 0){
+            if(pushFile(input_file) != 0){
                return -1;
             }
 
@@ -64,7 +78,7 @@ int main(int argc, char *argv[]){
 
         case 5:
         case 6:
-            if(pushFile(argv[2]) != 0){
+            if(pushFile(input_file) != 0){
                return -1;
             }
 
@@ -0,0 +1,586 @@
+#include "opt.h"
+#include "cfg.h"
+#include "global.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// ---- Passes ----
+
+// Label a jump to `label` ends up at, following labels that are
+// immediately followed by an unconditional jump
+static int final_target(IRList *ir, int label) {
+    // Bounded so a cycle of jumps (an empty infinite loop) terminates
+    for (int hops = 0; hops < 16; hops++) {
+        int i = ir_label_target(ir, label);
+        if (i < 0) break;
+
+        while (i < ir->count && (ir->code[i].kind == IR_LABEL || ir->code[i].kind == IR_NOP)) i++;
+        if (i >= ir->count || ir->code[i].kind != IR_JUMP || ir->code[i].i == label) break;
+
+        label = ir->code[i].i;
+    }
+    return label;
+}
+
+// Retarget jumps that land on another unconditional jump
+static int pass_jump_thread(IRList *ir, AST *func) {
+    int changed = 0;
+
+    ir_resolve_labels(ir);
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        for (int k = 0; k < ir_jump_count(ir, p); k++) {
+            int *label = ir_jump_label(ir, p, k);
+            int target = final_target(ir, *label);
+            if (target != *label) {
+                *label = target;
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+// Instructions that push one value and can be deleted with it: they have no
+// side effects and cannot throw
+static bool is_pure_value(IRInstruction *p) {
+    switch (p->kind) {
+        case IR_PUSH_INT: case IR_PUSH_FLOAT: case IR_PUSH_STRING:
+        case IR_LOAD_LOCAL: case IR_LOAD_GLOBAL:
+        case IR_ADD: case IR_SUB: case IR_MUL:
+        case IR_BIT_AND: case IR_BIT_OR: case IR_BIT_XOR: case IR_SHL: case IR_SHR:
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_NEG: case IR_BIT_NOT: case IR_CAST_I2F: case IR_CAST_F2I:
+            return true;
+        case IR_DIV: case IR_MOD:
+            return p->type == IRT_FLOAT;        // idiv and irem can throw
+        default:
+            return false;
+    }
+}
+
+// Which instruction produced each stack operand of each instruction in a
+// block, or -1 if it came from another block or an instruction that
+// pushes more than one value
+typedef struct {
+    int (*operand)[2];      // producers of the top two operands: [0] below, [1] top
+    int *stack;
+    int capacity;
+} Producers;
+
+static void find_producers(IRList *ir, int start, int end, Producers *pr) {
+    int depth = 0;
+
+    for (int i = start; i < end; i++) {
+        IRInstruction *p = &ir->code[i];
+        int pops, pushes;
+        ir_stack_effect(p, &pops, &pushes);
+
+        pr->operand[i][0] = pr->operand[i][1] = -1;
+        if (pops >= 1) pr->operand[i][1] = depth >= 1 ? pr->stack[depth - 1] : -1;
+        if (pops >= 2) pr->operand[i][0] = depth >= 2 ? pr->stack[depth - 2] : -1;
+
+        // Values from earlier blocks sit below the bottom of this stack
+        depth = depth >= pops ? depth - pops : 0;
+
+        if (depth + pushes > pr->capacity) {
+            pr->capacity = (depth + pushes) * 2;
+            pr->stack = realloc(pr->stack, pr->capacity * sizeof(int));
+        }
+        for (int k = 0; k < pushes; k++) {
+            pr->stack[depth++] = (pushes == 1 || p->kind == IR_DUP) ? i : -1;
+        }
+    }
+}
+
+// True if instruction i and everything feeding it can be deleted outright
+static bool removable_tree(IRList *ir, Producers *pr, int i) {
+    if (i < 0 || !is_pure_value(&ir->code[i])) return false;
+
+    int pops, pushes;
+    ir_stack_effect(&ir->code[i], &pops, &pushes);
+    for (int k = 2 - pops; k < 2; k++) {
+        if (!removable_tree(ir, pr, pr->operand[i][k])) return false;
+    }
+    return true;
+}
+
+static void remove_tree(IRList *ir, Producers *pr, int i) {
+    int pops, pushes;
+    ir_stack_effect(&ir->code[i], &pops, &pushes);
+    for (int k = 2 - pops; k < 2; k++) {
+        remove_tree(ir, pr, pr->operand[i][k]);
+    }
+    ir->code[i].kind = IR_NOP;
+}
+
+static void make_pop(IRInstruction *p) {
+    p->kind = IR_POP;
+    p->type = IRT_NONE;
+    p->flags = 0;
+    p->i = 0;
+}
+
+// Delete computations whose only use is a pop. Returns the number of pops
+// removed or moved.
+static int remove_dead_values(IRList *ir, CFG *cfg, Producers *pr) {
+    int changed = 0;
+
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+        bool again = true;
+
+        // Each deletion can expose another pop, so rescan until nothing changes
+        while (again) {
+            again = false;
+            find_producers(ir, bb->start, bb->end, pr);
+
+            for (int i = bb->start; i < bb->end && !again; i++) {
+                if (ir->code[i].kind != IR_POP) continue;
+
+                int j = pr->operand[i][1];
+                if (j < 0) continue;
+                IRInstruction *q = &ir->code[j];
+
+                if (q->kind == IR_DUP) {
+                    // The other copy stands in for the value that was duplicated
+                    q->kind = IR_NOP;
+                    ir->code[i].kind = IR_NOP;
+                    again = true;
+                } else if (removable_tree(ir, pr, j)) {
+                    remove_tree(ir, pr, j);
+                    ir->code[i].kind = IR_NOP;
+                    again = true;
+                } else if (is_pure_value(q)) {
+                    // Drop the operation but keep popping the operands that
+                    // cannot be deleted, at most two: one in its place and one
+                    // in place of the pop
+                    int pops, pushes, kept = 0;
+                    ir_stack_effect(q, &pops, &pushes);
+                    for (int k = 2 - pops; k < 2; k++) {
+                        int operand = pr->operand[j][k];
+                        if (removable_tree(ir, pr, operand)) {
+                            remove_tree(ir, pr, operand);
+                        } else {
+                            kept++;
+                        }
+                    }
+                    if (kept == pops && pops == 1) continue;    // nothing gained
+
+                    if (kept >= 1) make_pop(q); else q->kind = IR_NOP;
+                    if (kept < 2) ir->code[i].kind = IR_NOP;
+                    again = true;
+                }
+                if (again) changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+// Remove unreachable blocks, dead values, jumps to the next instruction
+// and labels that are never jumped to
+static int pass_dce(IRList *ir, AST *func) {
+    int changed = 0;
+    Producers pr = { NULL, NULL, 0 };
+
+    for (int round = 0; round < 8; round++) {
+        int before = changed;
+        CFG cfg;
+        cfg_build(&cfg, ir);
+
+        for (int b = 0; b < cfg.count; b++) {
+            BasicBlock *bb = &cfg.blocks[b];
+            if (bb->rpo_index >= 0) continue;
+            for (int i = bb->start; i < bb->end; i++) {
+                ir->code[i].kind = IR_NOP;
+                changed++;
+            }
+        }
+
+        pr.operand = realloc(pr.operand, (ir->count ? ir->count : 1) * sizeof(*pr.operand));
+        changed += remove_dead_values(ir, &cfg, &pr);
+        cfg_free(&cfg);
+
+        // A jump whose target label comes before any other instruction
+        for (int i = 0; i < ir->count; i++) {
+            IRInstruction *p = &ir->code[i];
+            if (!ir_is_jump(p->kind)) continue;
+
+            int pops, pushes;
+            ir_stack_effect(p, &pops, &pushes);
+            if (pops > 1) continue;
+
+            for (int k = i + 1; k < ir->count; k++) {
+                IRInstruction *q = &ir->code[k];
+                if (q->kind == IR_LABEL && q->i == p->i) {
+                    if (pops == 1) make_pop(p); else p->kind = IR_NOP;
+                    changed++;
+                    break;
+                }
+                if (q->kind != IR_LABEL && q->kind != IR_NOP) break;
+            }
+        }
+
+        char *used = calloc(ir->label_count ? ir->label_count : 1, 1);
+        for (int i = 0; i < ir->count; i++) {
+            for (int k = 0; k < ir_jump_count(ir, &ir->code[i]); k++) {
+                used[*ir_jump_label(ir, &ir->code[i], k)] = 1;
+            }
+        }
+        for (int i = 0; i < ir->count; i++) {
+            if (ir->code[i].kind == IR_LABEL && !used[ir->code[i].i]) {
+                ir->code[i].kind = IR_NOP;
+                changed++;
+            }
+        }
+        free(used);
+
+        ir_remove_nops(ir);
+        if (changed == before) break;
+    }
+
+    free(pr.operand);
+    free(pr.stack);
+    return changed;
+}
+
+// Constant added to an int local by `LOAD n; PUSH c; ADD|SUB` (or
+// `PUSH c; LOAD n; ADD`) starting at i, in range for a (wide) iinc
+static bool match_increment(IRList *ir, int i, int *slot, int *imm) {
+    if (i + 2 >= ir->count) return false;
+
+    IRInstruction *a = &ir->code[i], *b = &ir->code[i + 1], *op = &ir->code[i + 2];
+    if (op->type != IRT_INT && op->type != IRT_CHAR) return false;
+
+    long c;
+    if (a->kind == IR_LOAD_LOCAL && b->kind == IR_PUSH_INT && (op->kind == IR_ADD || op->kind == IR_SUB)) {
+        *slot = a->i;
+        c = op->kind == IR_ADD ? (long)b->i : -(long)b->i;
+    } else if (a->kind == IR_PUSH_INT && b->kind == IR_LOAD_LOCAL && op->kind == IR_ADD) {
+        *slot = b->i;
+        c = a->i;
+    } else {
+        return false;
+    }
+
+    if (c < -32768 || c > 32767 || *slot > 65535) return false;
+    *imm = (int)c;
+    return true;
+}
+
+static void make_inc(IRInstruction *p, int slot, int imm) {
+    p->kind = IR_INC;
+    p->type = IRT_INT;
+    p->flags = 0;
+    p->i = slot;
+    p->imm = imm;
+}
+
+// Select iinc for constant updates of int locals:
+//   LOAD n; PUSH c; ADD; STORE n            ->  INC n c
+//   LOAD n; DUP; PUSH c; ADD; STORE n       ->  LOAD n; INC n c     (n++ as a value)
+//   LOAD n; PUSH c; ADD; DUP; STORE n       ->  INC n c; LOAD n     (++n as a value)
+static int pass_iinc(IRList *ir, AST *func) {
+    int changed = 0;
+    int slot, imm;
+
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+
+        if (match_increment(ir, i, &slot, &imm) && i + 3 < ir->count) {
+            IRInstruction *next = &ir->code[i + 3];
+            if (next->kind == IR_STORE_LOCAL && next->i == slot) {
+                make_inc(p, slot, imm);
+                ir->code[i + 1].kind = IR_NOP;
+                ir->code[i + 2].kind = IR_NOP;
+                next->kind = IR_NOP;
+                changed++;
+            } else if (next->kind == IR_DUP && i + 4 < ir->count &&
+                       ir->code[i + 4].kind == IR_STORE_LOCAL && ir->code[i + 4].i == slot) {
+                make_inc(p, slot, imm);
+                ir->code[i + 1].kind = IR_NOP;
+                ir->code[i + 2].kind = IR_NOP;
+                ir->code[i + 3].kind = IR_NOP;
+                ir->code[i + 4].kind = IR_LOAD_LOCAL;
+                ir->code[i + 4].type = IRT_INT;
+                changed++;
+            }
+        } else if (p->kind == IR_LOAD_LOCAL && i + 4 < ir->count && ir->code[i + 1].kind == IR_DUP) {
+            IRInstruction *push = &ir->code[i + 2], *op = &ir->code[i + 3], *store = &ir->code[i + 4];
+            if (push->kind == IR_PUSH_INT && (op->kind == IR_ADD || op->kind == IR_SUB) &&
+                (op->type == IRT_INT || op->type == IRT_CHAR) &&
+                store->kind == IR_STORE_LOCAL && store->i == p->i) {
+                long c = op->kind == IR_ADD ? (long)push->i : -(long)push->i;
+                if (c >= -32768 && c <= 32767 && p->i <= 65535) {
+                    ir->code[i + 1].kind = IR_NOP;
+                    push->kind = IR_NOP;
+                    op->kind = IR_NOP;
+                    make_inc(store, p->i, (int)c);
+                    changed++;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+// log2 of a power of two, or -1
+static int exact_log2(unsigned int c) {
+    if (c == 0 || (c & (c - 1)) != 0) return -1;
+    int k = 0;
+    while (c >>= 1) k++;
+    return k;
+}
+
+// Replace multiplications by powers of two with shifts, and float
+// division by a power of two with multiplication by its exact reciprocal.
+// Signed division and remainder by 2^k are left alone: a shift or mask
+// rounds negative dividends the wrong way and the fix-up costs more than
+// it saves.
+static int pass_strength(IRList *ir, AST *func) {
+    int changed = 0;
+
+    for (int i = 1; i < ir->count; i++) {
+        IRInstruction *op = &ir->code[i], *c = &ir->code[i - 1];
+
+        if (op->kind == IR_MUL && op->type != IRT_FLOAT) {
+            // x * 2^k, or 2^k * y where y is a single load or push
+            if (c->kind == IR_PUSH_INT && exact_log2((unsigned int)c->i) > 0) {
+                c->i = exact_log2((unsigned int)c->i);
+                op->kind = IR_SHL;
+                changed++;
+            } else if (i >= 2 && ir->code[i - 2].kind == IR_PUSH_INT &&
+                       exact_log2((unsigned int)ir->code[i - 2].i) > 0 &&
+                       (c->kind == IR_LOAD_LOCAL || c->kind == IR_PUSH_INT)) {
+                IRInstruction y = *c;
+                ir->code[i - 1] = ir->code[i - 2];
+                ir->code[i - 1].i = exact_log2((unsigned int)ir->code[i - 2].i);
+                ir->code[i - 2] = y;
+                op->kind = IR_SHL;
+                changed++;
+            }
+        } else if (op->kind == IR_DIV && op->type == IRT_FLOAT && c->kind == IR_PUSH_FLOAT) {
+            // c = +-2^k exactly when the mantissa bits are clear; both c and
+            // its reciprocal must be normal floats
+            unsigned int bits;
+            memcpy(&bits, &c->f, sizeof bits);
+            unsigned int exponent = (bits >> 23) & 0xff;
+            if ((bits & 0x7fffff) == 0 && exponent >= 1 && exponent <= 253) {
+                c->f = 1.0f / c->f;
+                op->kind = IR_MUL;
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+static const Pass passes[] = {
+    { "tailcall", "turn self-recursive tail calls into jumps to the entry", pass_tail_calls },
+    { "switch", "turn equality test chains on one variable into jump tables", pass_switch_conv },
+    { "sccp", "propagate constants through locals, drop dead branches", pass_sccp },
+    { "promote", "keep globals in locals across loops that call no user function", pass_promote_globals },
+    { "licm", "compute loop-invariant expressions once before the loop", pass_licm },
+    { "copy-prop", "forward stores to loads, propagate copies, drop dead stores", pass_copy_prop },
+    { "lvn", "reuse repeated computations within a block", pass_lvn },
+    { "jump-thread", "retarget jumps to jumps", pass_jump_thread },
+    { "dce", "remove unreachable code, dead values and redundant jumps and labels", pass_dce },
+    { "strength", "turn power-of-two multiplies into shifts", pass_strength },
+    { "iinc", "use iinc for constant updates of int locals", pass_iinc },
+    { "slots", "share local slots between variables that are never live together", pass_slots },
+};
+#define NUM_PASSES ((int)(sizeof(passes) / sizeof(passes[0])))
+
+// Pipelines for -O0, -O1 and -O2
+static const char *level_pipelines[] = {
+    "",
+    "tailcall,switch,sccp,promote,licm,copy-prop,jump-thread,dce,strength,iinc,slots",
+    "tailcall,switch,sccp,promote,licm,copy-prop,lvn,jump-thread,dce,strength,iinc,slots",
+};
+
+// ---- Pipeline selection ----
+
+static int find_pass(const char *name, size_t len) {
+    for (int i = 0; i < NUM_PASSES; i++) {
+        if (strlen(passes[i].name) == len && strncmp(passes[i].name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Resolve a comma separated list into pass indices; returns the count or
+// -1 after reporting an unknown name
+static int parse_pipeline(const char *list, int *out, int max) {
+    int n = 0;
+    const char *p = list;
+
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+
+        if (len > 0) {
+            int idx = find_pass(p, len);
+            if (idx < 0) {
+                fprintf(stderr, "Unknown pass %.*s. Available passes:\n", (int)len, p);
+                for (int i = 0; i < NUM_PASSES; i++) {
+                    fprintf(stderr, "  %-16s %s\n", passes[i].name, passes[i].description);
+                }
+                return -1;
+            }
+            if (n < max) out[n++] = idx;
+        }
+
+        p += len;
+        if (*p == ',') p++;
+    }
+    return n;
+}
+
+bool opt_pipeline_valid(const char *list) {
+    int scratch[64];
+    return parse_pipeline(list, scratch, 64) >= 0;
+}
+
+#define MAX_PIPELINE 64
+static int pipeline[MAX_PIPELINE];
+static int pipeline_len = 0;
+static pthread_once_t pipeline_once = PTHREAD_ONCE_INIT;
+
+static void init_pipeline() {
+    const char *list = opt_passes;
+    if (!list) {
+        int level = opt_level < 0 ? 0 : opt_level > 2 ? 2 : opt_level;
+        list = level_pipelines[level];
+    }
+    pipeline_len = parse_pipeline(list, pipeline, MAX_PIPELINE);
+    if (pipeline_len < 0) pipeline_len = 0;
+}
+
+// ---- Statistics ----
+
+typedef struct {
+    int runs;
+    double seconds;
+    long removed;       // net instructions removed (negative if the pass grew the code)
+    long changed;
+} PassStats;
+
+static PassStats stats[NUM_PASSES];
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void opt_report(FILE *out) {
+    fprintf(out, "Pass statistics:\n");
+    fprintf(out, "  %-16s %6s %10s %9s %9s\n", "pass", "runs", "time(ms)", "removed", "changed");
+    for (int i = 0; i < NUM_PASSES; i++) {
+        if (stats[i].runs == 0) continue;
+        fprintf(out, "  %-16s %6d %10.3f %9ld %9ld\n", passes[i].name, stats[i].runs,
+                stats[i].seconds * 1000.0, stats[i].removed, stats[i].changed);
+    }
+}
+
+// ---- Verifier ----
+
+bool ir_verify(IRList *ir, const char *func_name, const char *after) {
+    bool ok = true;
+    char *defined = calloc(ir->label_count ? ir->label_count : 1, 1);
+
+#define VERIFY_ERROR(...) do { \
+        fprintf(stderr, "IR verifier: function %s after %s: ", func_name, after); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ok = false; \
+    } while (0)
+
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        if (p->kind >= IR_NUM_KINDS) {
+            VERIFY_ERROR("instruction %d has invalid kind %d", i, p->kind);
+        } else if (p->kind == IR_LABEL) {
+            if (p->i < 0 || p->i >= ir->label_count) {
+                VERIFY_ERROR("instruction %d places out of range label L%d", i, p->i);
+            } else if (defined[p->i]) {
+                VERIFY_ERROR("label L%d placed twice", p->i);
+            } else {
+                defined[p->i] = 1;
+            }
+        }
+    }
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        if (p->kind == IR_SWITCH && (p->i < 0 || p->i >= ir->switch_count)) {
+            VERIFY_ERROR("instruction %d uses out of range jump table T%d", i, p->i);
+            continue;
+        }
+        for (int k = 0; k < ir_jump_count(ir, p); k++) {
+            int label = *ir_jump_label(ir, p, k);
+            if (label < 0 || label >= ir->label_count || !defined[label]) {
+                VERIFY_ERROR("instruction %d jumps to undefined label L%d", i, label);
+            }
+        }
+    }
+    free(defined);
+    if (!ok) return false;
+
+    // Stack depth must never go negative and must agree wherever paths join
+    CFG cfg;
+    cfg_build(&cfg, ir);
+    StackDepths d;
+    cfg_stack_depths(&cfg, ir_stack_effect, &d);
+    if (d.underflow >= 0) {
+        VERIFY_ERROR("stack underflow at instruction %d", d.underflow);
+    }
+    if (d.edge_from >= 0) {
+        VERIFY_ERROR("stack depth %d on edge B%d -> B%d but %d on another path",
+                     d.edge_depth, d.edge_from, d.edge_to, d.other_depth);
+    }
+
+#undef VERIFY_ERROR
+
+    stack_depths_free(&d);
+    cfg_free(&cfg);
+    return ok;
+}
+
+// ---- Driver ----
+
+void opt_run(IRList *ir, AST *func) {
+    const char *name = func ? func->func.name : "?";
+    pthread_once(&pipeline_once, init_pipeline);
+
+#ifdef DEBUG
+    ir_verify(ir, name, "lowering");
+#endif
+
+    for (int i = 0; i < pipeline_len; i++) {
+        const Pass *pass = &passes[pipeline[i]];
+        int before = ir->count;
+        double start = now_seconds();
+
+        int changed = pass->run(ir, func);
+        ir_remove_nops(ir);
+
+        double elapsed = now_seconds() - start;
+
+        pthread_mutex_lock(&stats_lock);
+        stats[pipeline[i]].runs++;
+        stats[pipeline[i]].seconds += elapsed;
+        stats[pipeline[i]].removed += before - ir->count;
+        stats[pipeline[i]].changed += changed;
+        pthread_mutex_unlock(&stats_lock);
+
+#ifdef DEBUG
+        ir_verify(ir, name, pass->name);
+#endif
+    }
+    (void)name;
+}
@@ -0,0 +1,47 @@
+#ifndef OPT_H
+#define OPT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "ast.h"
+
+// An IR optimization pass. run rewrites one function's IR in place and
+// returns the number of instructions it changed; deleted instructions are
+// turned into IR_NOP and counted by the pass manager once it compacts them.
+typedef struct {
+    const char *name;
+    const char *description;
+    int (*run)(IRList *ir, AST *func);
+} Pass;
+
+// Passes implemented in their own files
+int pass_sccp(IRList *ir, AST *func);
+int pass_copy_prop(IRList *ir, AST *func);
+int pass_lvn(IRList *ir, AST *func);
+int pass_switch_conv(IRList *ir, AST *func);
+int pass_slots(IRList *ir, AST *func);
+int pass_tail_calls(IRList *ir, AST *func);
+int pass_promote_globals(IRList *ir, AST *func);
+int pass_licm(IRList *ir, AST *func);
+
+// Inline small non-recursive functions into their callers (-O1 and up,
+// --inline-limit). funcs[k] has already been lowered to irs[k]; this runs
+// before any function's pipeline.
+void inline_functions(AST **funcs, IRList *irs, int count);
+
+// Check that pass names in a comma separated list exist
+bool opt_pipeline_valid(const char *list);
+
+// Run the selected pipeline (--passes, else -O level) over one function
+void opt_run(IRList *ir, AST *func);
+
+// Check IR invariants: labels, jump targets and a consistent stack depth at
+// every instruction. Reports problems on stderr and returns false if any.
+bool ir_verify(IRList *ir, const char *func_name, const char *after);
+
+// Print per-pass statistics gathered by opt_run (--pass-stats)
+void opt_report(FILE *out);
+
+#endif
@@ -138,7 +138,7 @@ static struct Type *type_from_struct_name(const char *name) {
 %token BITWISE      308
 
 
-%type <ast> Program C Var Var_local Struct_def Struct_local_def Struct_members Struct_member Fun_dec Fun_proto Fun_def Stat_block Stat_block_body Stat unmatched_stmt matched_stmt expr assignment_expression conditional_expression logical_or_expression logical_and_expression bitwise_or_expression bitwise_xor_expression bitwise_and_expression equality_expression relational_expression additive_expression multiplicative_expression unary_expression postfix_expression primary lvalue lvalue_postfix argument_expression_list_opt argument_expression_list opt_assignment opt_ident_list opt_ident_local_list opt_param_list opt_param_list_tail opt_fun_body opt_expr opt_member_list INCRDEC_PREFIX
+%type <ast> Program C Var Var_local Struct_def Struct_local_def Struct_members Struct_member Fun_dec Fun_proto Fun_def Stat_block Stat_block_body Stat unmatched_stmt matched_stmt expr assignment_expression conditional_expression logical_or_expression logical_and_expression bitwise_or_expression bitwise_xor_expression bitwise_and_expression equality_expression relational_expression additive_expression multiplicative_expression unary_expression postfix_expression primary lvalue lvalue_postfix argument_expression_list_opt argument_expression_list opt_assignment opt_ident_list opt_ident_local_list opt_param_list opt_param_list_tail opt_fun_body opt_expr opt_member_list INCRDEC_PREFIX Case_list Case_clause
 
 %type <type> opt_const_type type_with_struct
 %type <boolval> opt_array opt_empty_array
@@ -398,9 +398,24 @@ matched_stmt : Stat_block   { $$ = $1; }
 
              | IF '(' expr ')' matched_stmt ELSE matched_stmt
                     { $$ = ast_set_line_no(ast_if($3, $5, $7), yylineno); }
+
+             | SWITCH '(' expr ')' '{' Case_list '}'
+                    { $$ = ast_set_line_no(ast_switch($3, $6), yylineno); }
              ;
 
 
+/* Each label owns the statements up to the next one; control falls through between them */
+Case_list : { $$ = NULL; }
+          | Case_clause Case_list   { $$ = ast_list_prepend($1, $2); }
+          ;
+
+Case_clause : CASE expr ':' Stat_block_body
+                { $$ = ast_set_line_no(ast_case($2, ast_block_from_list($4)), yylineno); }
+            | DEFAULT ':' Stat_block_body
+                { $$ = ast_set_line_no(ast_case(NULL, ast_block_from_list($3)), yylineno); }
+            ;
+
+
 opt_expr : { $$ = NULL; }
          | expr { $$ = $1; }
          ;
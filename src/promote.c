@@ -0,0 +1,226 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Keep globals in locals across loops. Every access to a global is a
+// getstatic or putstatic; inside a loop that calls no user function nothing
+// else can see the global, so it can live in a fresh local instead:
+//
+//     LOAD g; STORE t                 (preheader, on every way in)
+//   header:
+//     ... LOAD t / STORE t ...        (every access in the loop)
+//     LOAD t; STORE g                 (on every way out, if the loop stores g)
+//
+// Exits are loop blocks falling through, branching or switching to a block
+// outside the loop, and returns inside it. A fall-through exit gets the
+// write-back in place; a jump out is redirected to a pad at the end of the
+// function that writes back and jumps on. Library calls never touch our
+// globals, so they do not stop a loop from being promoted.
+//
+// The outermost loop that qualifies is promoted; loops inside a loop with
+// a call are still considered on their own. One loop is promoted per round
+// and the CFG rebuilt, so later loops see the preheaders and pads of
+// earlier ones. A promoted loop has no global accesses left.
+
+typedef struct {
+    const char *name;
+    IRType type;
+    int slot;
+    bool stored;
+} Promoted;
+
+typedef struct {
+    IRList *ir;
+    CFG *cfg;
+    IRList *before;         // instructions to insert before each instruction
+    IRList *after;          // and after it
+    IRList pads;            // exit pads, appended to the function
+    int next_slot;
+} Promoter;
+
+static void emit_writeback(IRList *l, Promoted *g, int count) {
+    for (int k = 0; k < count; k++) {
+        if (!g[k].stored) continue;
+        ir_emit(l, IR_LOAD_LOCAL, g[k].type, g[k].slot);
+        ir_emit_name(l, IR_STORE_GLOBAL, g[k].type, g[k].name);
+    }
+}
+
+static int find_promoted(Promoted *g, int count, const char *name) {
+    for (int k = 0; k < count; k++) {
+        if (strcmp(g[k].name, name) == 0) return k;
+    }
+    return -1;
+}
+
+// Promote the globals of one loop; false if the loop does not qualify
+static bool promote_loop(Promoter *pr, Loop *loop) {
+    IRList *ir = pr->ir;
+    CFG *cfg = pr->cfg;
+
+    if (!cfg_loop_has_preheader_slot(cfg, loop)) return false;
+
+    Promoted *g = NULL;
+    int count = 0;
+    bool bad = false;
+
+    for (int b = 0; b < cfg->count && !bad; b++) {
+        if (!bitset_test(&loop->body, b)) continue;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            IRInstruction *p = &ir->code[i];
+            if (p->kind == IR_CALL && (!p->callee || !is_stdlib_function(p->callee->name))) {
+                bad = true;
+                break;
+            }
+            if ((p->kind != IR_LOAD_GLOBAL && p->kind != IR_STORE_GLOBAL) || !p->s) continue;
+
+            int k = find_promoted(g, count, p->s);
+            if (k < 0) {
+                g = realloc(g, (count + 1) * sizeof(Promoted));
+                k = count++;
+                g[k].name = p->s;
+                g[k].type = p->type;
+                g[k].slot = -1;
+                g[k].stored = false;
+            }
+            // One global always has one type; anything else is not ours to touch
+            if (g[k].type != p->type) bad = true;
+            if (p->kind == IR_STORE_GLOBAL) g[k].stored = true;
+        }
+    }
+    if (bad || count == 0) {
+        free(g);
+        return false;
+    }
+
+    bool stores = false;
+    for (int k = 0; k < count; k++) {
+        g[k].slot = pr->next_slot++;
+        if (g[k].stored) stores = true;
+    }
+
+    // Preheader: a new label for jumps from outside, then the loads
+    int pre = ir_new_label(ir);
+    cfg_retarget_loop_entries(cfg, loop, pre);
+    IRList *entry = &pr->before[cfg->blocks[loop->header].start];
+    ir_emit(entry, IR_LABEL, IRT_NONE, pre);
+    for (int k = 0; k < count; k++) {
+        ir_emit_name(entry, IR_LOAD_GLOBAL, g[k].type, g[k].name);
+        ir_emit(entry, IR_STORE_LOCAL, g[k].type, g[k].slot);
+    }
+
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+        if (!bitset_test(&loop->body, b)) continue;
+
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInstruction *p = &ir->code[i];
+
+            if (p->kind == IR_LOAD_GLOBAL || p->kind == IR_STORE_GLOBAL) {
+                int k = find_promoted(g, count, p->s);
+                p->kind = p->kind == IR_LOAD_GLOBAL ? IR_LOAD_LOCAL : IR_STORE_LOCAL;
+                p->i = g[k].slot;
+                p->imm = 0;
+            } else if (p->kind == IR_RETURN || p->kind == IR_RETURN_VOID) {
+                emit_writeback(&pr->before[i], g, count);
+            }
+
+            // Jumps out of the loop go through a pad that writes back
+            for (int k = 0; stores && k < ir_jump_count(ir, p); k++) {
+                int *label = ir_jump_label(ir, p, k);
+                int target = ir_label_target(ir, *label);
+                if (target < 0 || bitset_test(&loop->body, cfg->block_of[target])) continue;
+
+                int pad = ir_new_label(ir);
+                ir_emit(&pr->pads, IR_LABEL, IRT_NONE, pad);
+                emit_writeback(&pr->pads, g, count);
+                ir_emit(&pr->pads, IR_JUMP, IRT_NONE, *label);
+                *label = pad;
+            }
+        }
+
+        // Falling out of the loop, or off the end of the function. The
+        // label starts a block of its own, outside the loop.
+        if (stores && bb->end > bb->start && cfg_falls_through(cfg, b) &&
+            (b + 1 >= cfg->count || !bitset_test(&loop->body, b + 1))) {
+            ir_emit(&pr->after[bb->end - 1], IR_LABEL, IRT_NONE, ir_new_label(ir));
+            emit_writeback(&pr->after[bb->end - 1], g, count);
+        }
+    }
+
+    free(g);
+    return true;
+}
+
+// Promote the first loop that qualifies and rewrite ir; false if none does
+static bool promote_first(IRList *ir, AST *func, int *next_slot) {
+    CFG cfg;
+    cfg_build(&cfg, ir);
+    if (cfg.loop_count == 0) {
+        cfg_free(&cfg);
+        return false;
+    }
+
+    int n = ir->count;
+    Promoter pr = {
+        .ir = ir,
+        .cfg = &cfg,
+        .before = calloc(n, sizeof(IRList)),
+        .after = calloc(n, sizeof(IRList)),
+        .next_slot = *next_slot,
+    };
+    irlist_init(&pr.pads);
+
+    bool changed = false;
+    for (int l = 0; l < cfg.loop_count && !changed; l++) {
+        changed = promote_loop(&pr, &cfg.loops[l]);
+    }
+
+    if (changed) {
+        IRList out;
+        irlist_init(&out);
+        for (int i = 0; i < n; i++) {
+            for (int k = 0; k < pr.before[i].count; k++) ir_append(&out, &pr.before[i].code[k]);
+            ir_append(&out, &ir->code[i]);
+            for (int k = 0; k < pr.after[i].count; k++) ir_append(&out, &pr.after[i].code[k]);
+        }
+
+        if (pr.pads.count > 0) {
+            // Keep the end of a void function from running into the pads
+            bool is_void = !func || !func->func.return_type || func->func.return_type->kind == TY_VOID;
+            if (is_void && cfg_falls_through(&cfg, cfg.count - 1)) {
+                ir_emit(&out, IR_RETURN_VOID, IRT_NONE, 0);
+            }
+            for (int k = 0; k < pr.pads.count; k++) ir_append(&out, &pr.pads.code[k]);
+        }
+
+        free(ir->code);
+        ir->code = out.code;
+        ir->count = out.count;
+        ir->capacity = out.capacity;
+        ir_resolve_labels(ir);
+    }
+
+    for (int i = 0; i < n; i++) {
+        free(pr.before[i].code);
+        free(pr.after[i].code);
+    }
+    free(pr.before);
+    free(pr.after);
+    free(pr.pads.code);
+    cfg_free(&cfg);
+    *next_slot = pr.next_slot;
+    return changed;
+}
+
+int pass_promote_globals(IRList *ir, AST *func) {
+    if (ir->count == 0) return 0;
+
+    int next_slot = ir_local_count(ir);
+    if (next_slot < ir_param_slots(func)) next_slot = ir_param_slots(func);
+
+    int changed = 0;
+    while (changed < 64 && promote_first(ir, func, &next_slot)) changed++;
+    return changed;
+}
@@ -0,0 +1,509 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Sparse conditional constant propagation over local variable slots.
+//
+// The IR is a stack machine, so the abstract state of a block is the value
+// of every local slot plus the values on the operand stack. Each value is
+// TOP (no information yet), a constant, or BOTTOM (varies). Only edges that
+// can be taken given the values found so far are followed, so code behind a
+// branch on a known value is never reached and its stores do not spoil the
+// constants reaching the join.
+
+typedef enum { LAT_TOP, LAT_CONST, LAT_BOTTOM } Lattice;
+
+typedef struct {
+    unsigned char lat;      // Lattice
+    bool is_float;
+    int i;
+    float f;
+} Value;
+
+static const Value bottom = { LAT_BOTTOM, false, 0, 0.0f };
+static const Value top = { LAT_TOP, false, 0, 0.0f };
+
+static Value const_int(int i) {
+    Value v = { LAT_CONST, false, i, 0.0f };
+    return v;
+}
+
+static Value const_float(float f) {
+    Value v = { LAT_CONST, true, 0, f };
+    return v;
+}
+
+static bool same_value(Value a, Value b) {
+    if (a.lat != b.lat) return false;
+    if (a.lat != LAT_CONST) return true;
+    if (a.is_float != b.is_float) return false;
+    // Compare floats bit for bit so that NaN meets NaN and -0.0 does not meet 0.0
+    return a.is_float ? memcmp(&a.f, &b.f, sizeof(float)) == 0 : a.i == b.i;
+}
+
+// Meet v into *dst; returns true if *dst changed
+static bool meet_value(Value *dst, Value v) {
+    if (v.lat == LAT_TOP || dst->lat == LAT_BOTTOM) return false;
+    if (dst->lat == LAT_TOP) {
+        *dst = v;
+        return true;
+    }
+    if (same_value(*dst, v)) return false;
+    *dst = bottom;
+    return true;
+}
+
+// State on entry to a block
+typedef struct {
+    bool reached;
+    bool queued;
+    int depth;
+    Value *stack;
+    Value *locals;
+} BlockState;
+
+typedef struct {
+    IRList *ir;
+    CFG cfg;
+    int nlocals;
+    BlockState *states;
+    int *worklist;
+    int worklist_len;
+
+    // Working state while a block is interpreted
+    Value *locals;
+    Value *stack;
+    int *producer;          // output index of the PUSH that made each stack value, or -1
+    int depth;
+    int stack_capacity;
+} SCCP;
+
+// ---- Evaluation ----
+
+static bool is_scalar(IRType t) {
+    return t == IRT_INT || t == IRT_CHAR || t == IRT_FLOAT;
+}
+
+// float -> int as f2i does it: NaN is 0, out of range values saturate
+static int f2i(float f) {
+    if (f != f) return 0;
+    if (f >= 2147483648.0f) return 2147483647;
+    if (f <= -2147483648.0f) return -2147483647 - 1;
+    return (int)f;
+}
+
+static bool compare_ints(IRKind k, int a, int b) {
+    switch (k) {
+        case IR_EQ: case IR_BR_EQ: return a == b;
+        case IR_NEQ: case IR_BR_NEQ: return a != b;
+        case IR_LT: case IR_BR_LT: return a < b;
+        case IR_GT: case IR_BR_GT: return a > b;
+        case IR_LE: case IR_BR_LE: return a <= b;
+        default: return a >= b;
+    }
+}
+
+// Ordered float comparison: false whenever an operand is NaN
+static bool compare_floats(IRKind k, float a, float b) {
+    if (a != a || b != b) return false;
+    switch (k) {
+        case IR_EQ: case IR_BR_EQ: return a == b;
+        case IR_NEQ: case IR_BR_NEQ: return a != b;
+        case IR_LT: case IR_BR_LT: return a < b;
+        case IR_GT: case IR_BR_GT: return a > b;
+        case IR_LE: case IR_BR_LE: return a <= b;
+        default: return a >= b;
+    }
+}
+
+// Result of a binary instruction on two values, with JVM semantics. Division
+// by zero is left BOTTOM so the exception still happens at run time.
+static Value eval_binary(IRInstruction *p, Value a, Value b) {
+    if (a.lat == LAT_BOTTOM || b.lat == LAT_BOTTOM) return bottom;
+    if (a.lat == LAT_TOP || b.lat == LAT_TOP) return top;
+
+    if (a.is_float || b.is_float) {
+        float x = a.is_float ? a.f : (float)a.i;
+        float y = b.is_float ? b.f : (float)b.i;
+        switch (p->kind) {
+            case IR_ADD: return const_float(x + y);
+            case IR_SUB: return const_float(x - y);
+            case IR_MUL: return const_float(x * y);
+            case IR_DIV: return const_float(x / y);
+            // C != is true when an operand is NaN, and is lowered that way
+            case IR_NEQ: return const_int(!compare_floats(IR_EQ, x, y));
+            case IR_EQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+                return const_int(compare_floats(p->kind, x, y));
+            default: return bottom;
+        }
+    }
+
+    unsigned int x = (unsigned int)a.i, y = (unsigned int)b.i;
+    switch (p->kind) {
+        case IR_ADD: return const_int((int)(x + y));
+        case IR_SUB: return const_int((int)(x - y));
+        case IR_MUL: return const_int((int)(x * y));
+        case IR_DIV:
+            if (b.i == 0) return bottom;
+            return const_int(b.i == -1 ? (int)(0u - x) : a.i / b.i);
+        case IR_MOD:
+            if (b.i == 0) return bottom;
+            return const_int(b.i == -1 ? 0 : a.i % b.i);
+        case IR_BIT_AND: return const_int(a.i & b.i);
+        case IR_BIT_OR: return const_int(a.i | b.i);
+        case IR_BIT_XOR: return const_int(a.i ^ b.i);
+        case IR_SHL: return const_int((int)(x << (y & 31)));
+        case IR_SHR: return const_int(a.i >> (y & 31));
+        case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            return const_int(compare_ints(p->kind, a.i, b.i));
+        default: return bottom;
+    }
+}
+
+static Value eval_unary(IRInstruction *p, Value a) {
+    if (a.lat != LAT_CONST) return a;
+
+    switch (p->kind) {
+        case IR_NEG:
+            return a.is_float ? const_float(-a.f) : const_int((int)(0u - (unsigned int)a.i));
+        case IR_BIT_NOT:
+            return a.is_float ? bottom : const_int(~a.i);
+        case IR_CAST_I2F:
+            return a.is_float ? bottom : const_float((float)a.i);
+        case IR_CAST_F2I:
+            return a.is_float ? const_int(f2i(a.f)) : bottom;
+        default:
+            return bottom;
+    }
+}
+
+static bool is_binary(IRKind k) {
+    return (k >= IR_ADD && k <= IR_MOD) || (k >= IR_BIT_AND && k <= IR_BIT_XOR) ||
+           (k >= IR_SHL && k <= IR_GE);
+}
+
+static bool is_unary(IRKind k) {
+    return k == IR_NEG || k == IR_BIT_NOT || k == IR_CAST_I2F || k == IR_CAST_F2I;
+}
+
+// Outcome of a conditional branch: 1 taken, 0 not taken, -1 unknown. A TOP
+// operand counts as unknown so that both edges stay live.
+static int eval_branch(IRInstruction *p, Value *operands) {
+    Value a = operands[0];
+    Value b = (p->kind == IR_JUMP_IF_ZERO || (p->flags & IRF_ZERO)) ? const_int(0) : operands[1];
+
+    if (a.lat != LAT_CONST || b.lat != LAT_CONST) return -1;
+
+    if (p->kind == IR_JUMP_IF_ZERO) return a.i == 0;
+
+    if (a.is_float || b.is_float) {
+        float x = a.is_float ? a.f : (float)a.i;
+        float y = b.is_float ? b.f : (float)b.i;
+        if (x != x || y != y) return (p->flags & IRF_UNORDERED) != 0;
+        return compare_floats(p->kind, x, y);
+    }
+    return compare_ints(p->kind, a.i, b.i);
+}
+
+// ---- Abstract interpretation of one block ----
+
+static void push(SCCP *s, Value v, int producer) {
+    if (s->depth == s->stack_capacity) {
+        s->stack_capacity = s->stack_capacity ? s->stack_capacity * 2 : 16;
+        s->stack = realloc(s->stack, s->stack_capacity * sizeof(Value));
+        s->producer = realloc(s->producer, s->stack_capacity * sizeof(int));
+    }
+    s->stack[s->depth] = v;
+    s->producer[s->depth] = producer;
+    s->depth++;
+}
+
+static void load_state(SCCP *s, int b) {
+    BlockState *st = &s->states[b];
+    memcpy(s->locals, st->locals, s->nlocals * sizeof(Value));
+    s->depth = 0;
+    for (int i = 0; i < st->depth; i++) push(s, st->stack[i], -1);
+}
+
+// Step over one instruction. With out set, the instruction (or its
+// replacement) is appended there; returns the branch outcome for
+// conditional branches, the label a switch is known to take, and -1
+// otherwise.
+static int step(SCCP *s, IRInstruction *p, IRList *out, int *changed) {
+    int pops, pushes;
+    ir_stack_effect(p, &pops, &pushes);
+    if (pops > s->depth) pops = s->depth;      // rejected by the verifier
+
+    Value *operands = &s->stack[s->depth - pops];
+    int *producers = &s->producer[s->depth - pops];
+
+    if (p->kind == IR_PUSH_INT || p->kind == IR_PUSH_FLOAT) {
+        int at = out ? out->count : -1;
+        if (out) ir_append(out, p);
+        push(s, p->kind == IR_PUSH_INT ? const_int(p->i) : const_float(p->f), at);
+        return -1;
+    }
+
+    if (p->kind == IR_LOAD_LOCAL) {
+        Value v = is_scalar(p->type) && p->i < s->nlocals ? s->locals[p->i] : bottom;
+        if (out && v.lat == LAT_CONST) {
+            if (v.is_float) {
+                ir_emit_float(out, v.f);
+            } else {
+                ir_emit(out, IR_PUSH_INT, p->type, v.i);
+            }
+            (*changed)++;
+            push(s, v, out->count - 1);
+        } else {
+            if (out) ir_append(out, p);
+            push(s, v, -1);
+        }
+        return -1;
+    }
+
+    if (p->kind == IR_INC) {
+        Value *v = &s->locals[p->i];
+        if (v->lat == LAT_CONST && !v->is_float) {
+            v->i = (int)((unsigned int)v->i + (unsigned int)p->imm);
+        } else if (v->lat == LAT_CONST) {
+            *v = bottom;
+        }
+        if (out) ir_append(out, p);
+        return -1;
+    }
+
+    if (p->kind == IR_STORE_LOCAL) {
+        if (p->i < s->nlocals) s->locals[p->i] = is_scalar(p->type) ? operands[0] : bottom;
+        s->depth -= pops;
+        if (out) ir_append(out, p);
+        return -1;
+    }
+
+    if ((is_binary(p->kind) || is_unary(p->kind)) && pops == (is_binary(p->kind) ? 2 : 1)) {
+        Value v = pops == 2 ? eval_binary(p, operands[0], operands[1]) : eval_unary(p, operands[0]);
+        bool removable = true;
+        for (int k = 0; k < pops; k++) {
+            if (producers[k] < 0) removable = false;
+        }
+
+        if (out && v.lat == LAT_CONST && removable) {
+            for (int k = 0; k < pops; k++) out->code[producers[k]].kind = IR_NOP;
+            s->depth -= pops;
+            if (v.is_float) {
+                ir_emit_float(out, v.f);
+            } else {
+                // Comparisons are typed by their operands; their result is an int
+                ir_emit(out, IR_PUSH_INT, p->type == IRT_CHAR ? IRT_CHAR : IRT_INT, v.i);
+            }
+            (*changed)++;
+            push(s, v, out->count - 1);
+        } else {
+            s->depth -= pops;
+            if (out) ir_append(out, p);
+            push(s, v, -1);
+        }
+        return -1;
+    }
+
+    if (ir_is_cond_branch(p->kind)) {
+        int taken = eval_branch(p, operands);
+        if (out && taken >= 0) {
+            // Drop the operands: delete their pushes where possible, pop the rest
+            for (int k = pops - 1; k >= 0; k--) {
+                if (producers[k] >= 0) {
+                    out->code[producers[k]].kind = IR_NOP;
+                } else {
+                    ir_emit(out, IR_POP, IRT_NONE, 0);
+                }
+            }
+            if (taken) ir_emit(out, IR_JUMP, IRT_NONE, p->i);
+            (*changed)++;
+        } else if (out) {
+            ir_append(out, p);
+        }
+        s->depth -= pops;
+        return taken;
+    }
+
+    if (p->kind == IR_SWITCH && pops == 1) {
+        int label = -1;
+        if (operands[0].lat == LAT_CONST && !operands[0].is_float) {
+            IRSwitch *t = &s->ir->switches[p->i];
+            label = t->default_label;
+            for (int k = 0; k < t->count; k++) {
+                if (t->keys[k] == operands[0].i) label = t->labels[k];
+            }
+        }
+        if (out && label >= 0) {
+            if (producers[0] >= 0) {
+                out->code[producers[0]].kind = IR_NOP;
+            } else {
+                ir_emit(out, IR_POP, IRT_NONE, 0);
+            }
+            ir_emit(out, IR_JUMP, IRT_NONE, label);
+            (*changed)++;
+        } else if (out) {
+            ir_append(out, p);
+        }
+        s->depth -= pops;
+        return label;
+    }
+
+    if (p->kind == IR_DUP && pops == 1) {
+        Value v = operands[0];
+        push(s, v, -1);
+        s->producer[s->depth - 2] = -1;     // the original can no longer be deleted alone
+        if (out) ir_append(out, p);
+        return -1;
+    }
+
+    s->depth -= pops;
+    for (int k = 0; k < pushes; k++) push(s, bottom, -1);
+    if (out) ir_append(out, p);
+    return -1;
+}
+
+// ---- Propagation ----
+
+static void enqueue(SCCP *s, int b) {
+    if (s->states[b].queued) return;
+    s->states[b].queued = true;
+    s->worklist[s->worklist_len++] = b;
+}
+
+// Merge the working state into successor b; returns false if the stack
+// depths disagree (malformed IR)
+static bool flow_into(SCCP *s, int b) {
+    BlockState *st = &s->states[b];
+
+    if (!st->reached) {
+        st->reached = true;
+        st->depth = s->depth;
+        st->stack = malloc((s->depth ? s->depth : 1) * sizeof(Value));
+        if (s->depth > 0) memcpy(st->stack, s->stack, s->depth * sizeof(Value));
+        if (s->nlocals > 0) memcpy(st->locals, s->locals, s->nlocals * sizeof(Value));
+        enqueue(s, b);
+        return true;
+    }
+    if (st->depth != s->depth) return false;
+
+    bool changed = false;
+    for (int i = 0; i < s->depth; i++) changed |= meet_value(&st->stack[i], s->stack[i]);
+    for (int i = 0; i < s->nlocals; i++) changed |= meet_value(&st->locals[i], s->locals[i]);
+    if (changed) enqueue(s, b);
+    return true;
+}
+
+// Interpret block b from its entry state and push the result along the
+// edges that can be taken
+static bool visit_block(SCCP *s, int b) {
+    BasicBlock *bb = &s->cfg.blocks[b];
+    IRList *ir = s->ir;
+    int changed = 0;
+    int taken = -1;
+
+    load_state(s, b);
+    for (int i = bb->start; i < bb->end; i++) {
+        taken = step(s, &ir->code[i], NULL, &changed);
+    }
+
+    IRInstruction *last = bb->end > bb->start ? &ir->code[bb->end - 1] : NULL;
+    bool falls_through = true;
+    bool jumps = false;
+
+    if (last && last->kind == IR_JUMP) {
+        falls_through = false;
+        jumps = true;
+    } else if (last && ir_is_cond_branch(last->kind)) {
+        jumps = taken != 0;
+        falls_through = taken != 1;
+    } else if (last && (last->kind == IR_RETURN || last->kind == IR_RETURN_VOID)) {
+        falls_through = false;
+    }
+
+    if (last && last->kind == IR_SWITCH) {
+        // Only the case a constant selects, or every case
+        falls_through = false;
+        for (int k = 0; k < ir_jump_count(ir, last); k++) {
+            int label = *ir_jump_label(ir, last, k);
+            int target = ir_label_target(ir, label);
+            if ((taken < 0 || taken == label) && target >= 0 &&
+                !flow_into(s, s->cfg.block_of[target])) return false;
+        }
+    }
+
+    if (jumps) {
+        int target = ir_label_target(ir, last->i);
+        if (target >= 0 && !flow_into(s, s->cfg.block_of[target])) return false;
+    }
+    if (falls_through && b + 1 < s->cfg.count && !flow_into(s, b + 1)) return false;
+    return true;
+}
+
+int pass_sccp(IRList *ir, AST *func) {
+    SCCP s;
+    memset(&s, 0, sizeof(s));
+    s.ir = ir;
+
+    if (ir->count == 0) return 0;
+
+    s.nlocals = ir_local_count(ir);
+
+    cfg_build(&s.cfg, ir);
+    s.states = calloc(s.cfg.count, sizeof(BlockState));
+    for (int b = 0; b < s.cfg.count; b++) {
+        s.states[b].locals = malloc((s.nlocals ? s.nlocals : 1) * sizeof(Value));
+        for (int i = 0; i < s.nlocals; i++) s.states[b].locals[i] = top;
+    }
+    s.worklist = malloc(s.cfg.count * sizeof(int));
+    s.locals = malloc((s.nlocals ? s.nlocals : 1) * sizeof(Value));
+
+    // Parameters arrive with unknown values; other locals are written
+    // before they are read
+    int nparams = ir_param_slots(func);
+    for (int i = 0; i < s.nlocals; i++) s.locals[i] = i < nparams ? bottom : top;
+    s.depth = 0;
+
+    bool ok = flow_into(&s, 0);
+    while (ok && s.worklist_len > 0) {
+        int b = s.worklist[--s.worklist_len];
+        s.states[b].queued = false;
+        ok = visit_block(&s, b);
+    }
+
+    int changed = 0;
+    if (ok) {
+        IRList out;
+        irlist_init(&out);
+        out.label_count = ir->label_count;
+
+        for (int b = 0; b < s.cfg.count; b++) {
+            BasicBlock *bb = &s.cfg.blocks[b];
+            if (!s.states[b].reached) continue;     // unreachable: dropped
+            load_state(&s, b);
+            for (int i = bb->start; i < bb->end; i++) {
+                step(&s, &ir->code[i], &out, &changed);
+            }
+        }
+
+        free(ir->code);
+        ir->code = out.code;
+        ir->count = out.count;
+        ir->capacity = out.capacity;
+        ir_resolve_labels(ir);
+        free(out.label_pos);
+    }
+
+    for (int b = 0; b < s.cfg.count; b++) {
+        free(s.states[b].locals);
+        free(s.states[b].stack);
+    }
+    free(s.states);
+    free(s.worklist);
+    free(s.locals);
+    free(s.stack);
+    free(s.producer);
+    cfg_free(&s.cfg);
+    return changed;
+}
@@ -0,0 +1,162 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Local slot allocation. The type checker gives every variable of every
+// scope its own slot, and passes add temporaries after them. Slots whose
+// live ranges never overlap are packed into the same JVM local, so the
+// frame is only as large as the number of values live at once.
+//
+// Two slots interfere when one is written while the other is live, or
+// when both are live on entry (parameters are written by the caller).
+// Slots are colored greedily in index order, parameters keeping their own
+// numbers. A slot is only merged with slots of the same kind of value
+// (int and char, float, or one reference type), and prefers the color of
+// a slot it is copied from or to, so the copy can disappear.
+
+// Slot kind for merging: int and char share one
+static int slot_class(IRType t) {
+    return t == IRT_CHAR ? IRT_INT : t;
+}
+
+static void interfere(Bitset *adj, int a, int b) {
+    if (a == b) return;
+    bitset_set(&adj[a], b);
+    bitset_set(&adj[b], a);
+}
+
+// Add an edge from slot d to every slot in live
+static void interfere_with_live(Bitset *adj, int d, const Bitset *live, int nlocals) {
+    for (int w = 0; w < live->nwords; w++) {
+        uint64_t bits = live->words[w];
+        while (bits) {
+            int l = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (l < nlocals) interfere(adj, d, l);
+        }
+    }
+}
+
+int pass_slots(IRList *ir, AST *func) {
+    int nlocals = ir_local_count(ir);
+    int nparams = ir_param_slots(func);
+    if (nlocals <= 1) return 0;
+
+    // Kind of value each slot holds, -1 if the code never touches it
+    int *cls = malloc(nlocals * sizeof(int));
+    int *hint = malloc(nlocals * sizeof(int));
+    for (int s = 0; s < nlocals; s++) cls[s] = hint[s] = -1;
+
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        if (p->kind == IR_LOAD_LOCAL || p->kind == IR_STORE_LOCAL) {
+            cls[p->i] = slot_class(p->type);
+        } else if (p->kind == IR_INC) {
+            cls[p->i] = IRT_INT;
+        }
+        if (p->kind == IR_STORE_LOCAL && i > 0 && ir->code[i - 1].kind == IR_LOAD_LOCAL) {
+            int from = ir->code[i - 1].i;
+            if (hint[p->i] < 0) hint[p->i] = from;
+            if (hint[from] < 0) hint[from] = p->i;
+        }
+    }
+
+    CFG cfg;
+    DataflowResult r;
+    cfg_build(&cfg, ir);
+    cfg_liveness(&cfg, nlocals, &r);
+
+    Bitset *adj = malloc(nlocals * sizeof(Bitset));
+    for (int s = 0; s < nlocals; s++) bitset_init(&adj[s], nlocals);
+
+    Bitset live;
+    bitset_init(&live, nlocals);
+    for (int b = 0; b < cfg.count; b++) {
+        BasicBlock *bb = &cfg.blocks[b];
+        bitset_copy(&live, &r.out[b]);
+        for (int i = bb->end - 1; i >= bb->start; i--) {
+            IRInstruction *q = &ir->code[i];
+            if (q->kind == IR_STORE_LOCAL || q->kind == IR_INC) {
+                interfere_with_live(adj, q->i, &live, nlocals);
+                if (q->kind == IR_STORE_LOCAL) bitset_clear(&live, q->i);
+            } else if (q->kind == IR_LOAD_LOCAL) {
+                bitset_set(&live, q->i);
+            }
+        }
+    }
+
+    // Everything live on entry, and every parameter, holds a value at once
+    bitset_copy(&live, &r.in[0]);
+    for (int s = 0; s < nparams && s < nlocals; s++) bitset_set(&live, s);
+    for (int s = 0; s < nlocals; s++) {
+        if (bitset_test(&live, s)) interfere_with_live(adj, s, &live, nlocals);
+    }
+
+    int *color = malloc(nlocals * sizeof(int));
+    int *color_cls = malloc(nlocals * sizeof(int));
+    char *taken = malloc(nlocals);
+    int ncolors = 0;
+
+    for (int s = 0; s < nlocals; s++) {
+        color[s] = -1;
+        if (s < nparams) {
+            color[s] = s;
+            color_cls[s] = cls[s];
+            ncolors = s + 1;
+        }
+    }
+    for (int s = nparams; s < nlocals; s++) {
+        if (cls[s] < 0) continue;
+
+        memset(taken, 0, nlocals);
+        for (int t = 0; t < nlocals; t++) {
+            if (color[t] >= 0 && bitset_test(&adj[s], t)) taken[color[t]] = 1;
+        }
+
+        int c = -1;
+        int h = hint[s];
+        if (h >= 0 && color[h] >= 0 && !taken[color[h]] && color_cls[color[h]] == cls[s]) {
+            c = color[h];
+        }
+        for (int k = 0; c < 0 && k < ncolors; k++) {
+            // An unused parameter's slot can hold anything
+            if (!taken[k] && (color_cls[k] == cls[s] || color_cls[k] < 0)) c = k;
+        }
+        if (c < 0) c = ncolors++;
+        if (c >= nparams || color_cls[c] < 0) color_cls[c] = cls[s];
+        color[s] = c;
+    }
+
+    int changed = 0;
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        if ((p->kind == IR_LOAD_LOCAL || p->kind == IR_STORE_LOCAL || p->kind == IR_INC) &&
+            color[p->i] != p->i) {
+            p->i = color[p->i];
+            changed++;
+        }
+    }
+
+    // Copies between slots that now coincide do nothing
+    for (int i = 1; i < ir->count; i++) {
+        IRInstruction *a = &ir->code[i - 1], *b = &ir->code[i];
+        if (a->kind == IR_LOAD_LOCAL && b->kind == IR_STORE_LOCAL && a->i == b->i) {
+            a->kind = IR_NOP;
+            b->kind = IR_NOP;
+            changed++;
+        }
+    }
+
+    for (int s = 0; s < nlocals; s++) bitset_free(&adj[s]);
+    free(adj);
+    bitset_free(&live);
+    dataflow_free(&r);
+    cfg_free(&cfg);
+    free(cls);
+    free(hint);
+    free(color);
+    free(color_cls);
+    free(taken);
+    return changed;
+}
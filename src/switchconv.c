@@ -0,0 +1,167 @@
+#include "opt.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Turn chains of equality tests on one variable into a jump table. An
+// `if (x == K1) ... else if (x == K2) ...` chain lowers to tests linked by
+// their not-equal branches:
+//
+//     LOAD x; PUSH K1; BR_NEQ L1
+//     ...                           (K1 case)
+//   L1:
+//     LOAD x; PUSH K2; BR_NEQ L2
+//     ...
+//
+// Nothing runs between the tests, so x cannot change and the first test
+// can become LOAD x; SWITCH, sending each key to the code after its test
+// and everything else to where the last test's branch went. The later
+// tests stay in place for any other jumps to their labels; dce removes
+// them when nothing reaches them.
+
+// Shorter chains are cheaper as compares
+#define SWITCH_MIN_CHAIN 4
+
+// One equality test: the variable load, the key and where a mismatch goes
+typedef struct {
+    int load;       // index of the LOAD_LOCAL or LOAD_GLOBAL
+    int branch;     // index of the BR_NEQ
+    int key;
+    int miss_label;
+} Test;
+
+static bool is_int_load(IRInstruction *p) {
+    return (p->kind == IR_LOAD_LOCAL || p->kind == IR_LOAD_GLOBAL) &&
+           (p->type == IRT_INT || p->type == IRT_CHAR);
+}
+
+static bool same_var(IRInstruction *a, IRInstruction *b) {
+    if (a->kind != b->kind) return false;
+    if (a->kind == IR_LOAD_LOCAL) return a->i == b->i;
+    return a->s && b->s && strcmp(a->s, b->s) == 0;
+}
+
+// LOAD x; PUSH k; BR_NEQ, PUSH k; LOAD x; BR_NEQ, or LOAD x; BR_NEQ_ZERO
+// starting at i
+static bool match_test(IRList *ir, int i, Test *t) {
+    if (i + 1 >= ir->count) return false;
+    IRInstruction *a = &ir->code[i], *b = &ir->code[i + 1];
+
+    if (is_int_load(a) && b->kind == IR_BR_NEQ && b->flags == IRF_ZERO) {
+        t->load = i;
+        t->branch = i + 1;
+        t->key = 0;
+        t->miss_label = b->i;
+        return true;
+    }
+
+    if (i + 2 >= ir->count) return false;
+    IRInstruction *br = &ir->code[i + 2];
+    if (br->kind != IR_BR_NEQ || br->flags != 0 || br->type == IRT_FLOAT) return false;
+
+    if (is_int_load(a) && b->kind == IR_PUSH_INT) {
+        t->load = i;
+        t->key = b->i;
+    } else if (a->kind == IR_PUSH_INT && is_int_load(b)) {
+        t->load = i + 1;
+        t->key = a->i;
+    } else {
+        return false;
+    }
+    t->branch = i + 2;
+    t->miss_label = br->i;
+    return true;
+}
+
+// First instruction at a label, skipping other labels
+static int after_labels(IRList *ir, int label) {
+    int i = ir_label_target(ir, label);
+    if (i < 0) return -1;
+    while (i < ir->count && (ir->code[i].kind == IR_LABEL || ir->code[i].kind == IR_NOP)) i++;
+    return i;
+}
+
+int pass_switch_conv(IRList *ir, AST *func) {
+    int changed = 0;
+    int n = ir->count;
+    int cap = 16;
+
+    // Label to place before each instruction, or -1
+    int *new_label = malloc((n ? n : 1) * sizeof(int));
+    char *in_chain = calloc(n ? n : 1, 1);
+    Test *chain = malloc(cap * sizeof(Test));
+    for (int i = 0; i < n; i++) new_label[i] = -1;
+
+    ir_resolve_labels(ir);
+    for (int i = 0; i < n; i++) {
+        Test t;
+        if (in_chain[i] || !match_test(ir, i, &t)) continue;
+
+        // Follow the mismatch edges while they lead to another test of x
+        int len = 0;
+        int at = i;
+        while (at >= 0 && at < n && !in_chain[at] && match_test(ir, at, &t) && t.branch + 1 < n &&
+               (len == 0 || same_var(&ir->code[t.load], &ir->code[chain[0].load]))) {
+            if (len == cap) {
+                cap *= 2;
+                chain = realloc(chain, cap * sizeof(Test));
+            }
+            chain[len++] = t;
+            in_chain[at] = 1;
+            at = after_labels(ir, t.miss_label);
+        }
+        if (len < SWITCH_MIN_CHAIN) continue;
+
+        // The first test of a repeated key wins; the later one is dead
+        int table = ir_new_switch(ir, chain[len - 1].miss_label);
+        int keys = 0;
+        for (int k = 0; k < len; k++) {
+            bool seen = false;
+            for (int j = 0; j < k; j++) {
+                if (chain[j].key == chain[k].key) seen = true;
+            }
+            if (seen) continue;
+
+            // The code after a test's branch is where its key goes
+            int hit = chain[k].branch + 1;
+            int label;
+            if (ir->code[hit].kind == IR_LABEL) {
+                label = ir->code[hit].i;
+            } else {
+                if (new_label[hit] < 0) new_label[hit] = ir_new_label(ir);
+                label = new_label[hit];
+            }
+            ir_switch_add(ir, table, chain[k].key, label);
+            keys++;
+        }
+
+        // LOAD x; SWITCH in place of the first test
+        IRInstruction load = ir->code[chain[0].load];
+        for (int k = i; k <= chain[0].branch; k++) ir->code[k].kind = IR_NOP;
+        ir->code[i] = load;
+        ir->code[i + 1].kind = IR_SWITCH;
+        ir->code[i + 1].type = IRT_INT;
+        ir->code[i + 1].flags = 0;
+        ir->code[i + 1].i = table;
+        changed += keys;
+    }
+
+    if (changed > 0) {
+        IRList out;
+        irlist_init(&out);
+        for (int i = 0; i < n; i++) {
+            if (new_label[i] >= 0) ir_emit(&out, IR_LABEL, IRT_NONE, new_label[i]);
+            ir_append(&out, &ir->code[i]);
+        }
+
+        free(ir->code);
+        ir->code = out.code;
+        ir->count = out.count;
+        ir->capacity = out.capacity;
+        ir_resolve_labels(ir);
+    }
+
+    free(new_label);
+    free(in_chain);
+    free(chain);
+    return changed;
+}
@@ -0,0 +1,96 @@
+#include "opt.h"
+#include "cfg.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Self tail call elimination. A call to the function itself whose result
+// is returned directly
+//
+//     <args>; CALL f; RETURN          (or a jump to a RETURN)
+//
+// becomes
+//
+//     STORE p(n-1) ... STORE p0; JUMP entry
+//
+// turning the recursion into a loop. The arguments are all evaluated before
+// the first store, so an argument may read any parameter. Only calls made
+// with nothing but their arguments on the stack qualify: jumping back to
+// the entry starts over with an empty stack.
+
+// True if control reaching instruction i returns straight away: through
+// labels and jumps to a RETURN, or for a void function off the end
+static bool returns_at(IRList *ir, int i, bool is_void) {
+    // Bounded so a cycle of jumps terminates
+    for (int hops = 0; hops < 16; hops++) {
+        while (i < ir->count && (ir->code[i].kind == IR_LABEL || ir->code[i].kind == IR_NOP)) i++;
+        if (i >= ir->count) return is_void;
+
+        IRInstruction *p = &ir->code[i];
+        if (p->kind == IR_RETURN) return !is_void;
+        if (p->kind == IR_RETURN_VOID) return is_void;
+        if (p->kind != IR_JUMP) return false;
+
+        i = ir_label_target(ir, p->i);
+        if (i < 0) return false;
+    }
+    return false;
+}
+
+int pass_tail_calls(IRList *ir, AST *func) {
+    if (!func || func->kind != AST_FUNC || ir->count == 0) return 0;
+
+    int nparams = ir_param_slots(func);
+    bool is_void = !func->func.return_type || func->func.return_type->kind == TY_VOID;
+
+    CFG cfg;
+    cfg_build(&cfg, ir);
+    StackDepths d;
+    cfg_stack_depths(&cfg, ir_stack_effect, &d);
+    cfg_free(&cfg);
+    int *depth = d.depth;
+    char *tail = calloc(ir->count, 1);
+    int changed = 0;
+
+    for (int i = 0; i < ir->count; i++) {
+        IRInstruction *p = &ir->code[i];
+        if (p->kind != IR_CALL || !p->callee || strcmp(p->callee->name, func->func.name) != 0) continue;
+        if (p->i != nparams || depth[i] != nparams) continue;
+        if (!returns_at(ir, i + 1, is_void)) continue;
+
+        tail[i] = 1;
+        changed++;
+    }
+
+    if (changed > 0) {
+        AST **params = malloc((nparams ? nparams : 1) * sizeof(AST *));
+        int k = 0;
+        for (AST *p = func->func.params; p; p = p->next) params[k++] = p;
+
+        int entry = ir_new_label(ir);
+        IRList out;
+        irlist_init(&out);
+        ir_emit(&out, IR_LABEL, IRT_NONE, entry);
+
+        for (int i = 0; i < ir->count; i++) {
+            if (!tail[i]) {
+                ir_append(&out, &ir->code[i]);
+                continue;
+            }
+            for (k = nparams - 1; k >= 0; k--) {
+                ir_emit(&out, IR_STORE_LOCAL, ir_type_of(params[k]->decl.decl_type), k);
+            }
+            ir_emit(&out, IR_JUMP, IRT_NONE, entry);
+        }
+
+        free(params);
+        free(ir->code);
+        ir->code = out.code;
+        ir->count = out.count;
+        ir->capacity = out.capacity;
+        ir_resolve_labels(ir);
+    }
+
+    free(depth);
+    free(tail);
+    return changed;
+}
@@ -320,6 +320,306 @@ static bool can_widen_to(Type *from, Type *to) {
 }
 
 
+// ---- Constant folding ----
+//
+// Run on each expression right after its type is known, so subtrees are
+// already folded. Integer arithmetic wraps and shift counts are masked to
+// five bits, as the JVM does at run time; division by zero is never folded
+// so it still traps. Folded literals keep the type computed above.
+
+typedef struct {
+    bool is_float;
+    int i;
+    float f;
+} ConstValue;
+
+static bool const_value(AST *n, ConstValue *v) {
+    v->is_float = false;
+    v->i = 0;
+    v->f = 0.0f;
+    switch (n->kind) {
+        case AST_INT_LITERAL: v->i = n->intval; return true;
+        case AST_CHAR_LITERAL: v->i = n->charval; return true;
+        case AST_BOOL_LITERAL: v->i = n->boolval ? 1 : 0; return true;
+        case AST_FLOAT_LITERAL: v->is_float = true; v->f = n->floatval; return true;
+        default: return false;
+    }
+}
+
+static float as_float(ConstValue v) {
+    return v.is_float ? v.f : (float)v.i;
+}
+
+// float -> int as f2i does it: NaN is 0, out of range values saturate
+static int float_to_int(float f) {
+    if (f != f) return 0;
+    if (f >= 2147483648.0f) return 2147483647;
+    if (f <= -2147483648.0f) return -2147483647 - 1;
+    return (int)f;
+}
+
+// Expressions that can be dropped without changing behaviour: no
+// assignments, calls or increments, and nothing that can trap
+static bool is_pure(AST *n) {
+    if (!n) return true;
+
+    switch (n->kind) {
+        case AST_INT_LITERAL:
+        case AST_FLOAT_LITERAL:
+        case AST_CHAR_LITERAL:
+        case AST_BOOL_LITERAL:
+        case AST_ID:
+            return true;
+        case AST_BINOP:
+            if (n->binop.op == OP_DIV || n->binop.op == OP_MOD) return false;
+            return is_pure(n->binop.left) && is_pure(n->binop.right);
+        case AST_LOGICAL_AND:
+        case AST_LOGICAL_OR:
+            return is_pure(n->logical.left) && is_pure(n->logical.right);
+        case AST_UNARY:
+            if (n->unary.op == UOP_PRE_INC || n->unary.op == UOP_PRE_DEC ||
+                n->unary.op == UOP_POST_INC || n->unary.op == UOP_POST_DEC) return false;
+            return is_pure(n->unary.operand);
+        default:
+            return false;
+    }
+}
+
+// Turn node into a literal of its own type. Char results that do not fit
+// in a char are left alone: char arithmetic is not truncated at run time.
+static bool make_literal(AST *node, ConstValue v) {
+    AST *children[3] = { NULL, NULL, NULL };
+
+    if (node->type->kind == TY_CHAR && (v.is_float || v.i < -128 || v.i > 127)) {
+        return false;
+    }
+    if (node->type->kind != TY_CHAR && node->type->kind != TY_INT && node->type->kind != TY_FLT) {
+        return false;
+    }
+
+    switch (node->kind) {
+        case AST_BINOP:
+            children[0] = node->binop.left;
+            children[1] = node->binop.right;
+            break;
+        case AST_LOGICAL_AND:
+        case AST_LOGICAL_OR:
+            children[0] = node->logical.left;
+            children[1] = node->logical.right;
+            break;
+        case AST_UNARY:
+            children[0] = node->unary.operand;
+            break;
+        case AST_TERNARY:
+            children[0] = node->ternary.cond;
+            children[1] = node->ternary.iftrue;
+            children[2] = node->ternary.iffalse;
+            break;
+        default:
+            break;
+    }
+
+    switch (node->type->kind) {
+        case TY_FLT:
+            node->kind = AST_FLOAT_LITERAL;
+            node->floatval = as_float(v);
+            break;
+        case TY_CHAR:
+            node->kind = AST_CHAR_LITERAL;
+            node->charval = (char)v.i;
+            break;
+        default:
+            node->kind = AST_INT_LITERAL;
+            node->intval = v.is_float ? float_to_int(v.f) : v.i;
+            break;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        ast_free(children[i]);
+    }
+    return true;
+}
+
+// Replace node by one of its operands (whose other parts were freed by the
+// caller). Only done when the operand already has the node's type.
+static bool replace_with(AST *node, AST *child) {
+    if (!child->type || child->type->kind != node->type->kind) {
+        return false;
+    }
+
+    AST *next = node->next;
+    *node = *child;
+    node->next = next;
+    free(child);
+    return true;
+}
+
+static bool fold_binop(AST *node) {
+    AST *l = node->binop.left, *r = node->binop.right;
+    ConstValue a, b, v = { false, 0, 0.0f };
+    bool lc = const_value(l, &a), rc = const_value(r, &b);
+    BinOpKind op = node->binop.op;
+
+    if (lc && rc) {
+        if (a.is_float || b.is_float) {
+            float x = as_float(a), y = as_float(b);
+            switch (op) {
+                case OP_ADD: v.is_float = true; v.f = x + y; break;
+                case OP_SUB: v.is_float = true; v.f = x - y; break;
+                case OP_MUL: v.is_float = true; v.f = x * y; break;
+                case OP_DIV: v.is_float = true; v.f = x / y; break;
+                case OP_EQ: v.i = x == y; break;
+                case OP_NEQ: v.i = x != y; break;
+                case OP_LT: v.i = x < y; break;
+                case OP_GT: v.i = x > y; break;
+                case OP_LE: v.i = x <= y; break;
+                case OP_GE: v.i = x >= y; break;
+                default: return false;
+            }
+        } else {
+            unsigned int x = (unsigned int)a.i, y = (unsigned int)b.i;
+            switch (op) {
+                case OP_ADD: v.i = (int)(x + y); break;
+                case OP_SUB: v.i = (int)(x - y); break;
+                case OP_MUL: v.i = (int)(x * y); break;
+                case OP_DIV:
+                    if (b.i == 0) return false;
+                    // INT_MIN / -1 overflows to INT_MIN, as idiv does
+                    v.i = (b.i == -1) ? (int)(0u - x) : a.i / b.i;
+                    break;
+                case OP_MOD:
+                    if (b.i == 0) return false;
+                    v.i = (b.i == -1) ? 0 : a.i % b.i;
+                    break;
+                case OP_BIT_AND: v.i = a.i & b.i; break;
+                case OP_BIT_OR: v.i = a.i | b.i; break;
+                case OP_BIT_XOR: v.i = a.i ^ b.i; break;
+                case OP_SHL: v.i = (int)(x << (y & 31)); break;
+                case OP_SHR: v.i = a.i >> (y & 31); break;
+                case OP_EQ: v.i = a.i == b.i; break;
+                case OP_NEQ: v.i = a.i != b.i; break;
+                case OP_LT: v.i = a.i < b.i; break;
+                case OP_GT: v.i = a.i > b.i; break;
+                case OP_LE: v.i = a.i <= b.i; break;
+                case OP_GE: v.i = a.i >= b.i; break;
+                default: return false;
+            }
+        }
+        return make_literal(node, v);
+    }
+
+    // Algebraic identities with one constant operand
+    bool is_float = node->type->kind == TY_FLT;
+    AST *keep = NULL, *drop = NULL;
+
+    if (rc && !b.is_float && b.i == 0 && !is_float &&
+        (op == OP_ADD || op == OP_SUB || op == OP_BIT_OR || op == OP_BIT_XOR ||
+         op == OP_SHL || op == OP_SHR)) {
+        keep = l; drop = r;                             // x+0 x-0 x|0 x^0 x<<0 x>>0
+    } else if (lc && !a.is_float && a.i == 0 && !is_float &&
+               (op == OP_ADD || op == OP_BIT_OR || op == OP_BIT_XOR)) {
+        keep = r; drop = l;                             // 0+x 0|x 0^x
+    } else if (rc && as_float(b) == 1.0f && (op == OP_MUL || op == OP_DIV)) {
+        keep = l; drop = r;                             // x*1 x/1
+    } else if (lc && as_float(a) == 1.0f && op == OP_MUL) {
+        keep = r; drop = l;                             // 1*x
+    } else if (!is_float && ((rc && !b.is_float && b.i == 0 && is_pure(l)) ||
+                             (lc && !a.is_float && a.i == 0 && is_pure(r))) &&
+               (op == OP_MUL || op == OP_BIT_AND)) {
+        return make_literal(node, v);                   // x*0 0*x x&0 0&x (v is 0)
+    }
+
+    if (keep && keep->type && keep->type->kind == node->type->kind) {
+        ast_free(drop);
+        return replace_with(node, keep);
+    }
+    return false;
+}
+
+static void fold_constants(AST *node) {
+    ConstValue a, v = { false, 0, 0.0f };
+
+    switch (node->kind) {
+        case AST_BINOP:
+            fold_binop(node);
+            break;
+
+        case AST_UNARY:
+            if (node->unary.op == UOP_PLUS) {
+                replace_with(node, node->unary.operand);
+                break;
+            }
+            if (!const_value(node->unary.operand, &a)) break;
+
+            switch (node->unary.op) {
+                case UOP_NEG:
+                    if (a.is_float) {
+                        v.is_float = true;
+                        v.f = -a.f;
+                    } else {
+                        v.i = (int)(0u - (unsigned int)a.i);
+                    }
+                    break;
+                case UOP_BITWISE_NOT:
+                    if (a.is_float) return;
+                    v.i = ~a.i;
+                    break;
+                case UOP_LOGICAL_NOT:
+                    v.i = a.is_float ? a.f == 0.0f : a.i == 0;
+                    break;
+                case UOP_CAST:
+                    // Only int <-> float casts change the value at run time
+                    if (a.is_float && node->type->kind != TY_FLT) {
+                        v.i = float_to_int(a.f);
+                    } else {
+                        v = a;
+                    }
+                    break;
+                default:
+                    return;
+            }
+            make_literal(node, v);
+            break;
+
+        case AST_LOGICAL_AND:
+        case AST_LOGICAL_OR: {
+            // A constant left operand decides the result, or the right
+            // operand is never evaluated; fold when the answer is known
+            bool is_and = node->kind == AST_LOGICAL_AND;
+            ConstValue b;
+            if (!const_value(node->logical.left, &a)) break;
+
+            bool left = a.is_float ? a.f != 0.0f : a.i != 0;
+            if (left != is_and) {
+                v.i = left;
+            } else if (const_value(node->logical.right, &b)) {
+                v.i = b.is_float ? b.f != 0.0f : b.i != 0;
+            } else {
+                break;
+            }
+            make_literal(node, v);
+            break;
+        }
+
+        case AST_TERNARY: {
+            if (!const_value(node->ternary.cond, &a)) break;
+
+            bool cond = a.is_float ? a.f != 0.0f : a.i != 0;
+            AST *keep = cond ? node->ternary.iftrue : node->ternary.iffalse;
+            AST *drop = cond ? node->ternary.iffalse : node->ternary.iftrue;
+            if (keep->type && keep->type->kind == node->type->kind) {
+                ast_free(node->ternary.cond);
+                ast_free(drop);
+                replace_with(node, keep);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
 static void type_check_node(AST *node) {
     if (!node) return;
 
@@ -521,6 +821,7 @@ static void type_check_node(AST *node) {
         if (node->type) {
             // All binops discard const
             node->type->is_const = false;
+            fold_constants(node);
         }
 
         break;
@@ -690,6 +991,7 @@ static void type_check_node(AST *node) {
         type_check_node(node->logical.left);
         type_check_node(node->logical.right);
         node->type = type_char(); // Logical operators return char (boolean)
+        fold_constants(node);
         break;
 
     case AST_TERNARY:
@@ -700,6 +1002,7 @@ static void type_check_node(AST *node) {
         if (node->ternary.iftrue->type && node->ternary.iffalse->type) {
             // Result type is from the true branch (simplified)
             node->type = node->ternary.iftrue->type;
+            fold_constants(node);
         } else {
             node->type = NULL;
         }
@@ -791,6 +1094,9 @@ static void type_check_node(AST *node) {
                 }
                 break;
         }
+        if (node->type) {
+            fold_constants(node);
+        }
         break;
 
     case AST_DECL:
@@ -1204,6 +1510,47 @@ static void type_check_node(AST *node) {
         node->type = type_void();
         break;
 
+    case AST_SWITCH: {
+        type_check_node(node->switch_stmt.expr);
+        if (node->switch_stmt.expr->type && !is_integral(node->switch_stmt.expr->type)) {
+            char buf[256];
+            snprintf(buf, sizeof(buf), "Switch expression must be int or char, got %s",
+                     type_to_string(node->switch_stmt.expr->type));
+            error(buf, node);
+        }
+
+        bool has_default = false;
+        for (AST *c = node->switch_stmt.cases; c; c = c->next) {
+            AST *value = c->case_stmt.value;
+            if (!value) {
+                if (has_default) error("Multiple default labels in one switch", c);
+                has_default = true;
+            } else {
+                // Folding turns constant expressions into literals
+                type_check_node(value);
+                if (value->kind != AST_INT_LITERAL && value->kind != AST_CHAR_LITERAL) {
+                    error("Case label must be an integer constant", c);
+                } else {
+                    int key = value->kind == AST_INT_LITERAL ? value->intval : value->charval;
+                    for (AST *d = node->switch_stmt.cases; d != c; d = d->next) {
+                        AST *other = d->case_stmt.value;
+                        if (!other || (other->kind != AST_INT_LITERAL && other->kind != AST_CHAR_LITERAL)) continue;
+                        if ((other->kind == AST_INT_LITERAL ? other->intval : other->charval) == key) {
+                            char buf[256];
+                            snprintf(buf, sizeof(buf), "Duplicate case value %d", key);
+                            error(buf, c);
+                            break;
+                        }
+                    }
+                }
+            }
+            type_check_node(c->case_stmt.body);
+            c->type = type_void();
+        }
+        node->type = type_void();
+        break;
+    }
+
     default:
         error("Unrecognized AST node kind in type checker", node);
         node->type = NULL;
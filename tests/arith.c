@@ -0,0 +1,48 @@
+int g;
+int h;
+
+int sq(int x) { return x * x; }
+int add3(int a, int b, int c) { return a + b + c; }
+int getg() { return g; }
+void setg(int v) { g = v; }
+int unusedfn(int x) { return x * 1000; }
+int unusedglobal;
+
+int main() {
+    int a, b, c, i, x;
+    a = 1024 * 4;
+    b = a * 1 + 0;
+    c = (b - 5) * 0;
+    putint(a); putchar(32); putint(b); putchar(32); putint(c); putchar(10);
+    putint(-17 / 4); putchar(32); putint(-17 % 4); putchar(32);
+    putint(17 / -4); putchar(32); putint(17 % -4); putchar(10);
+    x = -37;
+    putint(x / 8); putchar(32); putint(x % 8); putchar(32); putint(x * 16); putchar(32);
+    putint(x / 1); putchar(32); putint(x % 1); putchar(10);
+    x = 37;
+    putint(x / 8); putchar(32); putint(x % 8); putchar(32); putint(x * 16); putchar(10);
+    putint(2147483647 + 1); putchar(32);
+    putint(-2147483647 - 1); putchar(10);
+    putint(~5); putchar(32); putint(6 & 3); putchar(32); putint(6 | 3); putchar(10);
+    putint((int) 3.75); putchar(32); putint((int) ((float) 3 * 100.0)); putchar(10);
+    putint(5 < 3); putint(3 < 5); putint(2 == 2); putchar(10);
+    setg(7);
+    h = 0;
+    for (i = 0; i < 100; i++) {
+        h += sq(i) + add3(i, getg(), 1);
+    }
+    putint(h); putchar(10);
+    i = 5;
+    x = i++;
+    x = x + ++i;
+    putint(x); putint(i); putchar(10);
+    x = i--;
+    x = x - --i;
+    putint(x); putint(i); putchar(10);
+    i += 4; i -= 1; i *= 3; i /= 2; i %= 7;
+    putint(i); putchar(10);
+    g = 10;
+    g += 5; g *= 2;
+    putint(g); putchar(10);
+    return 0;
+}
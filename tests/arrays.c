@@ -0,0 +1,46 @@
+int ga[10];
+int gb[10];
+char buf[10];
+
+int sumarr(int a[], int n) {
+    int i, s;
+    s = 0;
+    for (i = 0; i < n; i++) s += a[i];
+    return s;
+}
+
+void fill(int a[], int n, int v) {
+    int i;
+    for (i = 0; i < n; i++) a[i] = v;
+}
+
+int main() {
+    int la[10];
+    int i, j, k, t;
+    for (i = 0; i < 10; i++) ga[i] = i * i - 3;
+    for (i = 0; i < 10; i++) gb[i] = ga[i];
+    for (i = 0; i < 10; i++) la[i] = ga[9 - i];
+    putint(sumarr(ga, 10)); putchar(32);
+    putint(sumarr(gb, 10)); putchar(32);
+    putint(sumarr(la, 10)); putchar(10);
+    fill(la, 10, 7);
+    putint(sumarr(la, 10)); putchar(10);
+    for (i = 0; i < 10; i++) la[i] = 0;
+    la[3] += 5; la[4] = la[3]++; la[5] = --la[3];
+    la[6] = (la[7] = 9) + 1;
+    for (i = 0; i < 10; i++) { putint(la[i]); putchar(32); }
+    putchar(10);
+    for (i = 0; i < 9; i++) {
+        for (j = 0; j < 9 - i; j++) {
+            if (ga[j] < ga[j + 1]) { t = ga[j]; ga[j] = ga[j + 1]; ga[j + 1] = t; }
+        }
+    }
+    for (i = 0; i < 10; i++) { putint(ga[i]); putchar(32); }
+    putchar(10);
+    k = 0;
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 3; j++)
+            k += ga[i * 3 + j] * ga[i * 3 + j] + ga[i * 3 + j];
+    putint(k); putchar(10);
+    return 0;
+}
@@ -0,0 +1,349 @@
+int big(int a) {
+    int v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62, v63, v64, v65, v66, v67, v68, v69, v70, v71, v72, v73, v74, v75, v76, v77, v78, v79, v80, v81, v82, v83, v84, v85, v86, v87, v88, v89, v90, v91, v92, v93, v94, v95, v96, v97, v98, v99, v100, v101, v102, v103, v104, v105, v106, v107, v108, v109, v110, v111, v112, v113, v114, v115, v116, v117, v118, v119, v120, v121, v122, v123, v124, v125, v126, v127, v128, v129, v130, v131, v132, v133, v134, v135, v136, v137, v138, v139, v140, v141, v142, v143, v144, v145, v146, v147, v148, v149, v150, v151, v152, v153, v154, v155, v156, v157, v158, v159, v160, v161, v162, v163, v164, v165, v166, v167, v168, v169, v170, v171, v172, v173, v174, v175, v176, v177, v178, v179, v180, v181, v182, v183, v184, v185, v186, v187, v188, v189, v190, v191, v192, v193, v194, v195, v196, v197, v198, v199, v200, v201, v202, v203, v204, v205, v206, v207, v208, v209, v210, v211, v212, v213, v214, v215, v216, v217, v218, v219, v220, v221, v222, v223, v224, v225, v226, v227, v228, v229, v230, v231, v232, v233, v234, v235, v236, v237, v238, v239, v240, v241, v242, v243, v244, v245, v246, v247, v248, v249, v250, v251, v252, v253, v254, v255, v256, v257, v258, v259, v260, v261, v262, v263, v264, v265, v266, v267, v268, v269, v270, v271, v272, v273, v274, v275, v276, v277, v278, v279, v280, v281, v282, v283, v284, v285, v286, v287, v288, v289, v290, v291, v292, v293, v294, v295, v296, v297, v298, v299;
+    v0 = a + 0;
+    v1 = v0 * 3 + 1;
+    v2 = v1 * 3 + 2;
+    v3 = v2 * 3 + 3;
+    v4 = v3 * 3 + 4;
+    v5 = v4 * 3 + 5;
+    v6 = v5 * 3 + 6;
+    v7 = v6 * 3 + 7;
+    v8 = v7 * 3 + 8;
+    v9 = v8 * 3 + 9;
+    v10 = v9 * 3 + 10;
+    v11 = v10 * 3 + 11;
+    v12 = v11 * 3 + 12;
+    v13 = v12 * 3 + 13;
+    v14 = v13 * 3 + 14;
+    v15 = v14 * 3 + 15;
+    v16 = v15 * 3 + 16;
+    v17 = v16 * 3 + 17;
+    v18 = v17 * 3 + 18;
+    v19 = v18 * 3 + 19;
+    v20 = v19 * 3 + 20;
+    v21 = v20 * 3 + 21;
+    v22 = v21 * 3 + 22;
+    v23 = v22 * 3 + 23;
+    v24 = v23 * 3 + 24;
+    v25 = v24 * 3 + 25;
+    v26 = v25 * 3 + 26;
+    v27 = v26 * 3 + 27;
+    v28 = v27 * 3 + 28;
+    v29 = v28 * 3 + 29;
+    v30 = v29 * 3 + 30;
+    v31 = v30 * 3 + 31;
+    v32 = v31 * 3 + 32;
+    v33 = v32 * 3 + 33;
+    v34 = v33 * 3 + 34;
+    v35 = v34 * 3 + 35;
+    v36 = v35 * 3 + 36;
+    v37 = v36 * 3 + 37;
+    v38 = v37 * 3 + 38;
+    v39 = v38 * 3 + 39;
+    v40 = v39 * 3 + 40;
+    v41 = v40 * 3 + 41;
+    v42 = v41 * 3 + 42;
+    v43 = v42 * 3 + 43;
+    v44 = v43 * 3 + 44;
+    v45 = v44 * 3 + 45;
+    v46 = v45 * 3 + 46;
+    v47 = v46 * 3 + 47;
+    v48 = v47 * 3 + 48;
+    v49 = v48 * 3 + 49;
+    v50 = v49 * 3 + 50;
+    v51 = v50 * 3 + 51;
+    v52 = v51 * 3 + 52;
+    v53 = v52 * 3 + 53;
+    v54 = v53 * 3 + 54;
+    v55 = v54 * 3 + 55;
+    v56 = v55 * 3 + 56;
+    v57 = v56 * 3 + 57;
+    v58 = v57 * 3 + 58;
+    v59 = v58 * 3 + 59;
+    v60 = v59 * 3 + 60;
+    v61 = v60 * 3 + 61;
+    v62 = v61 * 3 + 62;
+    v63 = v62 * 3 + 63;
+    v64 = v63 * 3 + 64;
+    v65 = v64 * 3 + 65;
+    v66 = v65 * 3 + 66;
+    v67 = v66 * 3 + 67;
+    v68 = v67 * 3 + 68;
+    v69 = v68 * 3 + 69;
+    v70 = v69 * 3 + 70;
+    v71 = v70 * 3 + 71;
+    v72 = v71 * 3 + 72;
+    v73 = v72 * 3 + 73;
+    v74 = v73 * 3 + 74;
+    v75 = v74 * 3 + 75;
+    v76 = v75 * 3 + 76;
+    v77 = v76 * 3 + 77;
+    v78 = v77 * 3 + 78;
+    v79 = v78 * 3 + 79;
+    v80 = v79 * 3 + 80;
+    v81 = v80 * 3 + 81;
+    v82 = v81 * 3 + 82;
+    v83 = v82 * 3 + 83;
+    v84 = v83 * 3 + 84;
+    v85 = v84 * 3 + 85;
+    v86 = v85 * 3 + 86;
+    v87 = v86 * 3 + 87;
+    v88 = v87 * 3 + 88;
+    v89 = v88 * 3 + 89;
+    v90 = v89 * 3 + 90;
+    v91 = v90 * 3 + 91;
+    v92 = v91 * 3 + 92;
+    v93 = v92 * 3 + 93;
+    v94 = v93 * 3 + 94;
+    v95 = v94 * 3 + 95;
+    v96 = v95 * 3 + 96;
+    v97 = v96 * 3 + 97;
+    v98 = v97 * 3 + 98;
+    v99 = v98 * 3 + 99;
+    v100 = v99 * 3 + 100;
+    v101 = v100 * 3 + 101;
+    v102 = v101 * 3 + 102;
+    v103 = v102 * 3 + 103;
+    v104 = v103 * 3 + 104;
+    v105 = v104 * 3 + 105;
+    v106 = v105 * 3 + 106;
+    v107 = v106 * 3 + 107;
+    v108 = v107 * 3 + 108;
+    v109 = v108 * 3 + 109;
+    v110 = v109 * 3 + 110;
+    v111 = v110 * 3 + 111;
+    v112 = v111 * 3 + 112;
+    v113 = v112 * 3 + 113;
+    v114 = v113 * 3 + 114;
+    v115 = v114 * 3 + 115;
+    v116 = v115 * 3 + 116;
+    v117 = v116 * 3 + 117;
+    v118 = v117 * 3 + 118;
+    v119 = v118 * 3 + 119;
+    v120 = v119 * 3 + 120;
+    v121 = v120 * 3 + 121;
+    v122 = v121 * 3 + 122;
+    v123 = v122 * 3 + 123;
+    v124 = v123 * 3 + 124;
+    v125 = v124 * 3 + 125;
+    v126 = v125 * 3 + 126;
+    v127 = v126 * 3 + 127;
+    v128 = v127 * 3 + 128;
+    v129 = v128 * 3 + 129;
+    v130 = v129 * 3 + 130;
+    v131 = v130 * 3 + 131;
+    v132 = v131 * 3 + 132;
+    v133 = v132 * 3 + 133;
+    v134 = v133 * 3 + 134;
+    v135 = v134 * 3 + 135;
+    v136 = v135 * 3 + 136;
+    v137 = v136 * 3 + 137;
+    v138 = v137 * 3 + 138;
+    v139 = v138 * 3 + 139;
+    v140 = v139 * 3 + 140;
+    v141 = v140 * 3 + 141;
+    v142 = v141 * 3 + 142;
+    v143 = v142 * 3 + 143;
+    v144 = v143 * 3 + 144;
+    v145 = v144 * 3 + 145;
+    v146 = v145 * 3 + 146;
+    v147 = v146 * 3 + 147;
+    v148 = v147 * 3 + 148;
+    v149 = v148 * 3 + 149;
+    v150 = v149 * 3 + 150;
+    v151 = v150 * 3 + 151;
+    v152 = v151 * 3 + 152;
+    v153 = v152 * 3 + 153;
+    v154 = v153 * 3 + 154;
+    v155 = v154 * 3 + 155;
+    v156 = v155 * 3 + 156;
+    v157 = v156 * 3 + 157;
+    v158 = v157 * 3 + 158;
+    v159 = v158 * 3 + 159;
+    v160 = v159 * 3 + 160;
+    v161 = v160 * 3 + 161;
+    v162 = v161 * 3 + 162;
+    v163 = v162 * 3 + 163;
+    v164 = v163 * 3 + 164;
+    v165 = v164 * 3 + 165;
+    v166 = v165 * 3 + 166;
+    v167 = v166 * 3 + 167;
+    v168 = v167 * 3 + 168;
+    v169 = v168 * 3 + 169;
+    v170 = v169 * 3 + 170;
+    v171 = v170 * 3 + 171;
+    v172 = v171 * 3 + 172;
+    v173 = v172 * 3 + 173;
+    v174 = v173 * 3 + 174;
+    v175 = v174 * 3 + 175;
+    v176 = v175 * 3 + 176;
+    v177 = v176 * 3 + 177;
+    v178 = v177 * 3 + 178;
+    v179 = v178 * 3 + 179;
+    v180 = v179 * 3 + 180;
+    v181 = v180 * 3 + 181;
+    v182 = v181 * 3 + 182;
+    v183 = v182 * 3 + 183;
+    v184 = v183 * 3 + 184;
+    v185 = v184 * 3 + 185;
+    v186 = v185 * 3 + 186;
+    v187 = v186 * 3 + 187;
+    v188 = v187 * 3 + 188;
+    v189 = v188 * 3 + 189;
+    v190 = v189 * 3 + 190;
+    v191 = v190 * 3 + 191;
+    v192 = v191 * 3 + 192;
+    v193 = v192 * 3 + 193;
+    v194 = v193 * 3 + 194;
+    v195 = v194 * 3 + 195;
+    v196 = v195 * 3 + 196;
+    v197 = v196 * 3 + 197;
+    v198 = v197 * 3 + 198;
+    v199 = v198 * 3 + 199;
+    v200 = v199 * 3 + 200;
+    v201 = v200 * 3 + 201;
+    v202 = v201 * 3 + 202;
+    v203 = v202 * 3 + 203;
+    v204 = v203 * 3 + 204;
+    v205 = v204 * 3 + 205;
+    v206 = v205 * 3 + 206;
+    v207 = v206 * 3 + 207;
+    v208 = v207 * 3 + 208;
+    v209 = v208 * 3 + 209;
+    v210 = v209 * 3 + 210;
+    v211 = v210 * 3 + 211;
+    v212 = v211 * 3 + 212;
+    v213 = v212 * 3 + 213;
+    v214 = v213 * 3 + 214;
+    v215 = v214 * 3 + 215;
+    v216 = v215 * 3 + 216;
+    v217 = v216 * 3 + 217;
+    v218 = v217 * 3 + 218;
+    v219 = v218 * 3 + 219;
+    v220 = v219 * 3 + 220;
+    v221 = v220 * 3 + 221;
+    v222 = v221 * 3 + 222;
+    v223 = v222 * 3 + 223;
+    v224 = v223 * 3 + 224;
+    v225 = v224 * 3 + 225;
+    v226 = v225 * 3 + 226;
+    v227 = v226 * 3 + 227;
+    v228 = v227 * 3 + 228;
+    v229 = v228 * 3 + 229;
+    v230 = v229 * 3 + 230;
+    v231 = v230 * 3 + 231;
+    v232 = v231 * 3 + 232;
+    v233 = v232 * 3 + 233;
+    v234 = v233 * 3 + 234;
+    v235 = v234 * 3 + 235;
+    v236 = v235 * 3 + 236;
+    v237 = v236 * 3 + 237;
+    v238 = v237 * 3 + 238;
+    v239 = v238 * 3 + 239;
+    v240 = v239 * 3 + 240;
+    v241 = v240 * 3 + 241;
+    v242 = v241 * 3 + 242;
+    v243 = v242 * 3 + 243;
+    v244 = v243 * 3 + 244;
+    v245 = v244 * 3 + 245;
+    v246 = v245 * 3 + 246;
+    v247 = v246 * 3 + 247;
+    v248 = v247 * 3 + 248;
+    v249 = v248 * 3 + 249;
+    v250 = v249 * 3 + 250;
+    v251 = v250 * 3 + 251;
+    v252 = v251 * 3 + 252;
+    v253 = v252 * 3 + 253;
+    v254 = v253 * 3 + 254;
+    v255 = v254 * 3 + 255;
+    v256 = v255 * 3 + 256;
+    v257 = v256 * 3 + 257;
+    v258 = v257 * 3 + 258;
+    v259 = v258 * 3 + 259;
+    v260 = v259 * 3 + 260;
+    v261 = v260 * 3 + 261;
+    v262 = v261 * 3 + 262;
+    v263 = v262 * 3 + 263;
+    v264 = v263 * 3 + 264;
+    v265 = v264 * 3 + 265;
+    v266 = v265 * 3 + 266;
+    v267 = v266 * 3 + 267;
+    v268 = v267 * 3 + 268;
+    v269 = v268 * 3 + 269;
+    v270 = v269 * 3 + 270;
+    v271 = v270 * 3 + 271;
+    v272 = v271 * 3 + 272;
+    v273 = v272 * 3 + 273;
+    v274 = v273 * 3 + 274;
+    v275 = v274 * 3 + 275;
+    v276 = v275 * 3 + 276;
+    v277 = v276 * 3 + 277;
+    v278 = v277 * 3 + 278;
+    v279 = v278 * 3 + 279;
+    v280 = v279 * 3 + 280;
+    v281 = v280 * 3 + 281;
+    v282 = v281 * 3 + 282;
+    v283 = v282 * 3 + 283;
+    v284 = v283 * 3 + 284;
+    v285 = v284 * 3 + 285;
+    v286 = v285 * 3 + 286;
+    v287 = v286 * 3 + 287;
+    v288 = v287 * 3 + 288;
+    v289 = v288 * 3 + 289;
+    v290 = v289 * 3 + 290;
+    v291 = v290 * 3 + 291;
+    v292 = v291 * 3 + 292;
+    v293 = v292 * 3 + 293;
+    v294 = v293 * 3 + 294;
+    v295 = v294 * 3 + 295;
+    v296 = v295 * 3 + 296;
+    v297 = v296 * 3 + 297;
+    v298 = v297 * 3 + 298;
+    v299 = v298 * 3 + 299;
+    return v0 + v7 + v14 + v21 + v28 + v35 + v42 + v49 + v56 + v63 + v70 + v77 + v84 + v91 + v98 + v105 + v112 + v119 + v126 + v133 + v140 + v147 + v154 + v161 + v168 + v175 + v182 + v189 + v196 + v203 + v210 + v217 + v224 + v231 + v238 + v245 + v252 + v259 + v266 + v273 + v280 + v287 + v294;
+}
+int temps(int a) {
+    int t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19, t20, t21, t22, t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    t0 = a + 0; a = t0 * 2 % 1000;
+    t1 = a + 1; a = t1 * 2 % 1000;
+    t2 = a + 2; a = t2 * 2 % 1000;
+    t3 = a + 3; a = t3 * 2 % 1000;
+    t4 = a + 4; a = t4 * 2 % 1000;
+    t5 = a + 5; a = t5 * 2 % 1000;
+    t6 = a + 6; a = t6 * 2 % 1000;
+    t7 = a + 7; a = t7 * 2 % 1000;
+    t8 = a + 8; a = t8 * 2 % 1000;
+    t9 = a + 9; a = t9 * 2 % 1000;
+    t10 = a + 10; a = t10 * 2 % 1000;
+    t11 = a + 11; a = t11 * 2 % 1000;
+    t12 = a + 12; a = t12 * 2 % 1000;
+    t13 = a + 13; a = t13 * 2 % 1000;
+    t14 = a + 14; a = t14 * 2 % 1000;
+    t15 = a + 15; a = t15 * 2 % 1000;
+    t16 = a + 16; a = t16 * 2 % 1000;
+    t17 = a + 17; a = t17 * 2 % 1000;
+    t18 = a + 18; a = t18 * 2 % 1000;
+    t19 = a + 19; a = t19 * 2 % 1000;
+    t20 = a + 20; a = t20 * 2 % 1000;
+    t21 = a + 21; a = t21 * 2 % 1000;
+    t22 = a + 22; a = t22 * 2 % 1000;
+    t23 = a + 23; a = t23 * 2 % 1000;
+    t24 = a + 24; a = t24 * 2 % 1000;
+    t25 = a + 25; a = t25 * 2 % 1000;
+    t26 = a + 26; a = t26 * 2 % 1000;
+    t27 = a + 27; a = t27 * 2 % 1000;
+    t28 = a + 28; a = t28 * 2 % 1000;
+    t29 = a + 29; a = t29 * 2 % 1000;
+    t30 = a + 30; a = t30 * 2 % 1000;
+    t31 = a + 31; a = t31 * 2 % 1000;
+    t32 = a + 32; a = t32 * 2 % 1000;
+    t33 = a + 33; a = t33 * 2 % 1000;
+    t34 = a + 34; a = t34 * 2 % 1000;
+    t35 = a + 35; a = t35 * 2 % 1000;
+    t36 = a + 36; a = t36 * 2 % 1000;
+    t37 = a + 37; a = t37 * 2 % 1000;
+    t38 = a + 38; a = t38 * 2 % 1000;
+    t39 = a + 39; a = t39 * 2 % 1000;
+    return a;
+}
+int main() { putint(big(3)); putchar(10); putint(temps(5)); putchar(10); return 0; }
@@ -0,0 +1,74 @@
+int mode;
+int calls;
+
+int next(int x) { calls++; return x; }
+
+int local_chain(int x) {
+    if (x == 3) return 30;
+    else if (x == 1) return 10;
+    else if (x == 4) return 40;
+    else if (2 == x) return 20;
+    else if (x == 9) return 90;
+    return -1;
+}
+
+int global_chain() {
+    if (mode == 0) return 7;
+    else if (mode == 1) return 8;
+    else if (mode == 2) return 9;
+    else if (mode == 1000) return 10;
+    else return 11;
+}
+
+int char_chain(char c) {
+    int r;
+    r = 0;
+    if (c == 'a') r = 1;
+    else if (c == 'b') r = 2;
+    else if (c == 'c') r = 3;
+    else if (c == 'z') r = 26;
+    return r;
+}
+
+int repeated(int x) {
+    if (x == 5) return 1;
+    else if (x == 6) return 2;
+    else if (x == 5) return 3;
+    else if (x == 7) return 4;
+    else if (x == 8) return 5;
+    return 0;
+}
+
+int side_effects(int x) {
+    if (next(x) == 1) return 1;
+    else if (next(x) == 2) return 2;
+    else if (next(x) == 3) return 3;
+    else if (next(x) == 4) return 4;
+    return 0;
+}
+
+int changing(int x) {
+    if (x == 1) return 1;
+    else if ((x = x + 1) == 3) return 3;
+    else if (x == 4) return 4;
+    else if (x == 5) return 5;
+    return x;
+}
+
+int main() {
+    int i, s;
+    for (i = 0; i < 11; i++) { putint(local_chain(i)); putchar(32); }
+    putchar(10);
+    for (mode = 0; mode < 4; mode++) { putint(global_chain()); putchar(32); }
+    mode = 1000; putint(global_chain()); putchar(10);
+    putint(char_chain('a')); putint(char_chain('c')); putint(char_chain('z')); putint(char_chain('q'));
+    putchar(10);
+    for (i = 4; i < 10; i++) { putint(repeated(i)); putchar(32); }
+    putchar(10);
+    s = 0;
+    for (i = 0; i < 6; i++) s = s * 10 + side_effects(i);
+    putint(s); putchar(32); putint(calls); putchar(10);
+    for (i = 0; i < 6; i++) { putint(changing(i)); putchar(32); }
+    putchar(10);
+    return 0;
+}
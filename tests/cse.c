@@ -0,0 +1,30 @@
+int grid[10];
+int n;
+int main() {
+    int a[10];
+    int i, j, s, x, y;
+    float f, g;
+    n = 3;
+    s = 0;
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            a[i * n + j] = i + j;
+            grid[i * n + j] = a[i * n + j] * a[i * n + j] + grid[i * n + j];
+        }
+    }
+    for (i = 1; i < 9; i++) {
+        s = s + grid[i] + grid[i - 1] + grid[i + 1] + grid[i] % 7;
+    }
+    x = 7; y = 9;
+    putint(s); putchar(32); putint(x * y + x * y); putchar(32);
+    f = 1.5; g = 2.5;
+    putint((int) ((f * g - f * g / 2.0) * 100.0)); putchar(10);
+    s = 0;
+    for (i = 0; i < 10; i++) {
+        s = s + grid[i] / (i + 1) + grid[i] / (i + 1);
+        grid[i] = 0;
+        s = s + grid[i];
+    }
+    putint(s); putchar(10);
+    return 0;
+}
@@ -0,0 +1,53 @@
+int g;
+
+int early(int x) {
+    if (x > 0) {
+        return 1;
+        g = 100;
+    }
+    return 2;
+    g = 200;
+}
+
+int loop_exit(int n) {
+    int i, s;
+    s = 0;
+    for (i = 0; i < n; i++) {
+        if (i == 4) {
+            break;
+            s = s + 1000;
+        }
+        if (i % 2) {
+            continue;
+            s = s + 100;
+        }
+        s = s + i;
+    }
+    return s;
+}
+
+int unused_values(int x) {
+    int a;
+    x + 1;
+    x * x;
+    a = x;
+    a++;
+    ++a;
+    a--;
+    g;
+    return a;
+}
+
+int main() {
+    int i;
+    putint(early(1)); putint(early(-1)); putint(g); putchar(10);
+    putint(loop_exit(3)); putchar(32); putint(loop_exit(10)); putchar(10);
+    i = 0;
+    i++;
+    i++;
+    putint(unused_values(i)); putchar(10);
+    if (0) putint(99);
+    while (0) putint(98);
+    putchar(10);
+    return 0;
+}
@@ -0,0 +1,30 @@
+int state;
+
+int step(int s, int x) {
+    if (s == 0) return x + 1;
+    else if (s == 1) return x * 2;
+    else if (s == 2) return x - 3;
+    else if (s == 3) return x / 2;
+    else if (s == 4) return x % 7;
+    else if (s == 5) return -x;
+    else return x;
+}
+
+int sparse(int k) {
+    if (k == 1) return 10;
+    else if (k == 100) return 20;
+    else if (k == 1000) return 30;
+    else if (k == -5) return 40;
+    return 0;
+}
+
+int main() {
+    int i, x;
+    x = 5;
+    for (i = 0; i < 100; i++) {
+        x = step(i % 8, x);
+    }
+    putint(x); putchar(10);
+    putint(sparse(1) + sparse(100) + sparse(1000) + sparse(-5) + sparse(7)); putchar(10);
+    return 0;
+}
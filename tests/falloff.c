@@ -0,0 +1,15 @@
+int calls;
+
+int h(int x) { if (x) return 1; }
+
+int k(int x) {
+    calls++;
+    if (x > 2) return x * 2;
+    else if (x > 0) return x;
+}
+
+int main() {
+    putint(h(3)); putchar(10);
+    putint(k(5) + k(1) + h(1)); putchar(32); putint(calls); putchar(10);
+    return 0;
+}
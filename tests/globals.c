@@ -0,0 +1,29 @@
+int counter;
+int limit;
+int acc[10];
+int unused_arr[10];
+
+void bump() { counter++; }
+
+int main() {
+    int i, j;
+    limit = 1000;
+    counter = 0;
+    for (i = 0; i < limit; i++) {
+        counter = counter + i % 3;
+    }
+    putint(counter); putchar(10);
+    for (i = 0; i < 10; i++) {
+        bump();
+    }
+    putint(counter); putchar(10);
+    j = 0;
+    while (j < 10) {
+        acc[j] = counter + j;
+        counter -= 1;
+        if (counter < 660) break;
+        j++;
+    }
+    putint(counter); putchar(32); putint(acc[0]); putchar(32); putint(j); putchar(10);
+    return 0;
+}
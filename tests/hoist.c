@@ -0,0 +1,61 @@
+int g;
+int scale;
+int data[10];
+
+int two_loops(int a, int b) {
+    int i, s;
+    s = 0;
+    for (i = 0; i < 10; i++) {
+        g = g + a * b + scale;
+        s = s + data[i] * scale;
+    }
+    for (i = 0; i < 10; i++) {
+        g = g - (a + b) * scale;
+        if (g < -500) break;
+        s = s + g % 5;
+    }
+    return s;
+}
+
+int nested(int a) {
+    int i, j, s;
+    s = 0;
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            g = g + a * scale + i;
+            s = s + g % 11;
+        }
+        for (j = 0; j < 3; j++) {
+            s = s + (a - scale) * j + g % 3;
+        }
+    }
+    return s;
+}
+
+int exits(int a, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        g = g + a * scale;
+        if (g > 200) return i;
+    }
+    while (i > 0) {
+        scale = scale + a * 2;
+        i--;
+        if (scale > 90) break;
+    }
+    return i;
+}
+
+int main() {
+    int i;
+    for (i = 0; i < 10; i++) data[i] = i * 3 - 4;
+    scale = 3;
+    putint(two_loops(2, 5)); putchar(32); putint(g); putchar(10);
+    g = 0;
+    putint(nested(4)); putchar(32); putint(g); putchar(10);
+    g = 0;
+    putint(exits(5, 20)); putchar(32); putint(g); putchar(32); putint(scale); putchar(10);
+    g = 0; scale = 1;
+    putint(exits(1, 4)); putchar(32); putint(g); putchar(32); putint(scale); putchar(10);
+    return 0;
+}
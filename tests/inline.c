@@ -0,0 +1,81 @@
+int counter;
+int table[10];
+
+int sq(int x) { return x * x; }
+int add3(int a, int b, int c) { return a + b + c; }
+int sumsq(int a, int b) { return sq(a) + sq(b); }
+int absv(int x) { if (x < 0) return -x; return x; }
+int clamp(int x, int lo, int hi) {
+    if (x < lo) return lo;
+    if (x > hi) return hi;
+    return x;
+}
+void bump() { counter = counter + 1; }
+void bumpby(int n) { if (n == 0) return; counter = counter + n; }
+int get(int i) { return table[i]; }
+void set(int i, int v) { table[i] = v; }
+float half(float f) { return f / 2.0; }
+float mix(float a, float b, float t) { return a * t + b; }
+int kind(int c) {
+    switch (c) {
+        case 1: return 10;
+        case 2: return 20;
+        case 3: return 30;
+        case 4: return 40;
+        default: return 0;
+    }
+    return 0;
+}
+int first(int a[]) { return a[0]; }
+int local_arr(int v) {
+    int t[3];
+    t[0] = v;
+    t[1] = v + 1;
+    t[2] = t[0] + t[1];
+    return t[2];
+}
+int fact(int n) { if (n <= 1) return 1; return n * fact(n - 1); }
+int iseven(int n) { if (n == 0) return 1; if (n == 1) return 0; return iseven(n - 2); }
+int isodd(int n) { return 1 - iseven(n); }
+int tick() { counter = counter + 1; return counter; }
+int big(int x) {
+    int a;
+    a = x;
+    a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1;
+    a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1;
+    a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1; a = a * 3 + 1;
+    return a;
+}
+
+int main() {
+    int i;
+    int s;
+    int arr[4];
+    float f;
+    s = 0;
+    for (i = 0; i < 10; i++) {
+        set(i, sq(i) - 20);
+    }
+    for (i = 0; i < 10; i++) {
+        s = s + absv(get(i)) + clamp(get(i), -5, 50) * 2 + add3(i, s, 1) % 7;
+        bump();
+        bumpby(i % 3);
+    }
+    putint(s); putchar(10);
+    putint(sumsq(3, 4) + 100 * sumsq(1, 2)); putchar(10);
+    putint(counter); putchar(10);
+    s = 0;
+    for (i = 0; i < 8; i++) s = s + kind(i) + i * kind(i % 5);
+    putint(s); putchar(10);
+    arr[0] = 42;
+    putint(first(arr) + local_arr(5) + local_arr(first(arr))); putchar(10);
+    f = half(7.0) + mix(1.5, 0.25, 3.0);
+    putint((int) (f * 100.0)); putchar(10);
+    putint(fact(6) + iseven(10) + isodd(7)); putchar(10);
+    tick();
+    tick();
+    putint(tick() * 10 + tick()); putchar(10);
+    putint(big(1) % 1000); putchar(10);
+    putint(sq(sq(3)) - add3(sq(2), absv(-3), clamp(100, 0, 9))); putchar(10);
+    return 0;
+}
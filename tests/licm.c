@@ -0,0 +1,79 @@
+int g;
+int garr[10];
+int side(int x) { g = g + x; return x; }
+int mulsum(int n, int m) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < 10; i++) s = s + n * m + i;
+    return s;
+}
+int zero_trip(int n, int d) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < n; i++) s = s + 100 / d + (n + d) * 2;
+    return s;
+}
+float fl(float a, float b, int n) {
+    float s;
+    int i;
+    s = 0.0;
+    for (i = 0; i < n; i++) s = s + a * b + (a / 4.0);
+    return s;
+}
+int nested(int a, int b) {
+    int i;
+    int j;
+    int s;
+    s = 0;
+    for (i = 0; i < 5; i++) {
+        for (j = 0; j < 5; j++) {
+            s = s + (a * b) + i * a + j;
+        }
+    }
+    return s;
+}
+int with_calls(int a) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < 5; i++) {
+        s = s + g * a + garr[i] + side(1);
+    }
+    return s;
+}
+int cond(int a, int b, int n) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < n; i++) {
+        if (i % 2 == 0) s = s + (a - b);
+        else if (a < b + 1) s = s - 1;
+    }
+    return s;
+}
+int changes(int a) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < 5; i++) {
+        s = s + a * 3;
+        a = a + 1;
+    }
+    return s;
+}
+int main() {
+    int i;
+    for (i = 0; i < 10; i++) garr[i] = i * 7;
+    g = 3;
+    putint(mulsum(3, 4)); putchar(10);
+    putint(zero_trip(0, 0)); putchar(10);
+    putint(zero_trip(4, 7)); putchar(10);
+    putint((int) (fl(1.5, 2.0, 4) * 100.0)); putchar(10);
+    putint(nested(2, 3)); putchar(10);
+    putint(with_calls(2)); putint(g); putchar(10);
+    putint(cond(9, 4, 7)); putchar(10);
+    putint(changes(2)); putchar(10);
+    return 0;
+}
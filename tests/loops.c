@@ -0,0 +1,58 @@
+int g;
+int total;
+
+int collatz(int n) {
+    int steps;
+    steps = 0;
+    while (n != 1) {
+        if (n % 2 == 0) n = n / 2;
+        else n = 3 * n + 1;
+        steps++;
+    }
+    return steps;
+}
+
+int nested(int n) {
+    int i, j, s;
+    s = 0;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            if (j > i) break;
+            if ((i + j) % 3 == 0) continue;
+            s += i * j;
+        }
+    }
+    return s;
+}
+
+int dowhile(int n) {
+    int s;
+    s = 0;
+    do {
+        s = s + n;
+        n--;
+    } while (n > 0);
+    return s;
+}
+
+int main() {
+    int i, best, bi;
+    best = 0; bi = 0;
+    for (i = 1; i < 200; i++) {
+        if (collatz(i) > best) { best = collatz(i); bi = i; }
+    }
+    putint(bi); putchar(32); putint(best); putchar(10);
+    putint(nested(30)); putchar(10);
+    putint(dowhile(100)); putchar(10);
+    i = 0;
+    while (1) {
+        i++;
+        if (i >= 50) break;
+        if (i % 7) continue;
+        g += i;
+    }
+    putint(g); putchar(10);
+    for (;;) { total++; if (total == 5) break; }
+    putint(total); putchar(10);
+    return 0;
+}
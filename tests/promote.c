@@ -0,0 +1,100 @@
+int total;
+int count;
+char last;
+float facc;
+int arr[10];
+int hits;
+
+int side(int x) { hits = hits + x; return x; }
+int sum_to(int n) {
+    int i;
+    total = 0;
+    for (i = 0; i < n; i++) {
+        total = total + i;
+        if (total > 100000) return -1;
+    }
+    return total;
+}
+void fill() {
+    int i;
+    i = 0;
+    while (i < 10) {
+        arr[i] = count * i;
+        count++;
+        i++;
+    }
+}
+int search(int key) {
+    int i;
+    for (i = 0; i < 10; i++) {
+        count = count + 1;
+        if (arr[i] == key) break;
+    }
+    return i;
+}
+void nested() {
+    int i;
+    int j;
+    for (i = 0; i < 5; i++) {
+        for (j = 0; j < 5; j++) {
+            total = total + i * j;
+            if (j == 2) last = 'q'; else last = 'z';
+        }
+        side(1);
+    }
+}
+void floats() {
+    int i;
+    facc = 0.0;
+    for (i = 0; i < 8; i++) facc = facc + 0.25;
+}
+int early(int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        count = count + 2;
+        if (count > 70) return count;
+    }
+    count = count - 1;
+    return 0;
+}
+void falloff(int n) {
+    while (n > 0) {
+        total = total + n;
+        n = n - 1;
+    }
+}
+int readonly(int n) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < n; i++) s = s + count + arr[i % 10];
+    return s;
+}
+int withcall() {
+    int i;
+    int t;
+    for (i = 0; i < 4; i++) {
+        t = side(i);
+        hits = hits + t;
+    }
+    return hits;
+}
+int main() {
+    putint(sum_to(100)); putchar(10);
+    putint(sum_to(1000)); putchar(10);
+    putint(total); putchar(10);
+    fill();
+    putint(count); putchar(10);
+    putint(search(12) + 100 * search(-1)); putchar(10);
+    putint(count); putchar(10);
+    total = 0;
+    nested();
+    putint(total + hits); putchar(last); putchar(10);
+    floats(); putint((int) (facc * 100.0)); putchar(10);
+    putint(early(5)); putint(count); putchar(10);
+    putint(early(50)); putint(count); putchar(10);
+    total = 0; falloff(10); putint(total); putchar(10);
+    putint(readonly(25)); putchar(10);
+    putint(withcall()); putchar(10);
+    return 0;
+}
@@ -0,0 +1,52 @@
+int g;
+int h;
+
+int f(int k) {
+    int i;
+    i = 0;
+    while (i < 20 && k) { g = g + i; i++; }
+    while (i < 30) { g = g - 1; i++; }
+    return i;
+}
+
+int chained(int n) {
+    int i, j;
+    i = 0;
+    while (i < n) {
+        h = h + i;
+        if (h > 50) break;
+        i++;
+    }
+    j = 0;
+    while (j < n) {
+        h = h * 2 + j;
+        if (h > 100000) return j;
+        j++;
+    }
+    for (i = 0; i < n; i++) {
+        g = g + h % 7;
+        if (g > 1000) break;
+    }
+    return i + j;
+}
+
+int three(int n) {
+    int i;
+    for (i = 0; i < n; i++) g = g + 1;
+    for (i = 0; i < n; i++) h = h + g;
+    for (i = 0; i < n; i++) { g = g - h % 3; h = h - 1; }
+    return g + h;
+}
+
+int main() {
+    putint(f(1)); putchar(32); putint(g); putchar(10);
+    g = 0;
+    putint(f(0)); putchar(32); putint(g); putchar(10);
+    g = 0; h = 0;
+    putint(chained(10)); putchar(32); putint(g); putchar(32); putint(h); putchar(10);
+    g = 0; h = 0;
+    putint(chained(30)); putchar(32); putint(g); putchar(32); putint(h); putchar(10);
+    g = 5; h = 2;
+    putint(three(12)); putchar(32); putint(g); putchar(32); putint(h); putchar(10);
+    return 0;
+}
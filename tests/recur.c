@@ -0,0 +1,34 @@
+int fact(int n, int acc) {
+    if (n <= 1) return acc;
+    return fact(n - 1, acc * n);
+}
+
+int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int gcd(int a, int b) {
+    if (b == 0) return a;
+    return gcd(b, a % b);
+}
+
+int sumto(int n, int acc) {
+    if (n == 0) return acc;
+    return sumto(n - 1, acc + n);
+}
+
+void countdown(int n) {
+    if (n == 0) return;
+    putint(n);
+    countdown(n - 1);
+}
+
+int main() {
+    putint(fact(10, 1)); putchar(10);
+    putint(fib(15)); putchar(10);
+    putint(gcd(1071, 462)); putchar(10);
+    putint(sumto(2000, 0)); putchar(10);
+    countdown(5); putchar(10);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Compile every tests/*.c at each optimization level, run the class and
+# compare what it prints, followed by "exit <status>", with <name>.expected.
+#
+#   tests/run.sh [path/to/mycc] [test names...]
+#
+# The .j file is assembled with Krakatau ($ASSEMBLE, default "krak2 asm")
+# and run with java; $LIB440 is the class path of the lib440 runtime. Set
+# JRUN to a command that runs a .j file directly to skip both. $LEVELS
+# lists the option sets to try (default "-O0 -O1 -O2").
+
+MYCC=${1:-./mycc}
+[ $# -gt 0 ] && shift
+MYCC=$(cd "$(dirname "$MYCC")" && pwd)/$(basename "$MYCC")
+TESTS=$(cd "$(dirname "$0")" && pwd)
+ASSEMBLE=${ASSEMBLE:-krak2 asm}
+LEVELS=${LEVELS:-"-O0 -O1 -O2"}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ $# -eq 0 ]; then
+    set -- $(cd "$TESTS" && ls *.c | sed 's/\.c$//')
+fi
+
+failed=0
+for name in "$@"; do
+    for level in $LEVELS; do
+        rm -rf "$WORK"/*
+        cp "$TESTS/$name.c" "$WORK/"
+        if ! (cd "$WORK" && "$MYCC" -5 "$name.c" $level > /dev/null 2> "$name.err") || [ ! -f "$WORK/$name.j" ]; then
+            echo "FAIL $name $level: compile"
+            cat "$WORK/$name.err"
+            failed=1
+            continue
+        fi
+
+        if [ -n "$JRUN" ]; then
+            (cd "$WORK" && $JRUN "$name.j") > "$WORK/$name.out" 2> "$WORK/$name.run"
+        else
+            (cd "$WORK" && $ASSEMBLE --out classes "$name.j" > /dev/null &&
+             java -cp "classes:$LIB440" "$name") > "$WORK/$name.out" 2> "$WORK/$name.run"
+        fi
+        echo "exit $?" >> "$WORK/$name.out"
+
+        if cmp -s "$WORK/$name.out" "$TESTS/$name.expected"; then
+            echo "ok   $name $level"
+        else
+            echo "FAIL $name $level"
+            diff "$TESTS/$name.expected" "$WORK/$name.out" | head -10
+            failed=1
+        fi
+    done
+done
+
+exit $failed
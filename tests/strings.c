@@ -0,0 +1,29 @@
+char g[6];
+
+int bump() {
+    char s[4] = "abc";
+    s[0] = (char) ((int) s[0] + 1);
+    putstring(s);
+    putstring("|");
+    return 0;
+}
+
+int main() {
+    int i;
+    char a[6];
+    for (i = 0; i < 5; i++) {
+        putstring("line ");
+        putint(i);
+        putstring("\n");
+    }
+    for (i = 0; i < 3; i++) bump();
+    putstring("\n");
+
+    a = "hello";
+    g = "hello";
+    a[0] = 'j';
+    g[4] = 'p';
+    putstring(a); putstring(" "); putstring(g); putstring(" "); putstring("hello");
+    putstring("\n");
+    return 0;
+}
@@ -0,0 +1,94 @@
+int calls;
+int next(int x) { calls++; return x; }
+
+int dense(int x) {
+    switch (x) {
+        case 0: return 10;
+        case 1: return 11;
+        case 2:
+        case 3: return 23;
+        case 5: return 15;
+        case 4: x = x + 100;
+        case 6: return x;
+        default: return -1;
+    }
+    return -2;
+}
+
+int sparse(int x) {
+    int r;
+    r = 0;
+    switch (next(x)) {
+        case -1000: r = 1; break;
+        case 7: r = 2; break;
+        default: r = 9;
+        case 100000: r = r + 3; break;
+        case 2147483647: r = 4; break;
+    }
+    return r;
+}
+
+int tiny(int x) {
+    int r;
+    r = 0;
+    switch (x) {
+        case 1: r = 5;
+        case 2: r = r + 6; break;
+    }
+    return r;
+}
+
+int chars(char c) {
+    switch (c) {
+        case 'a': return 1;
+        case 'e': return 2;
+        case 'i': return 3;
+        case 'o': return 4;
+        case 'u': return 5;
+    }
+    return 0;
+}
+
+int machine(int n) {
+    int state, i, out;
+    state = 0; out = 0;
+    for (i = 0; i < n; i++) {
+        switch (state) {
+            case 0: state = 3; out = out + 1; continue;
+            case 1: state = 0; out = out * 2; break;
+            case 2: state = 1; out = out - 3; break;
+            case 3: state = 2; out = out + 7; break;
+            case 4: out = 0;
+        }
+        out = out + i;
+    }
+    return out;
+}
+
+int chain(int x) {
+    if (x == 1) return 100;
+    else if (x == 2) return 200;
+    else if (3 == x) return 300;
+    else if (x == 0) return 400;
+    else if (x == 5) return 500;
+    else if (x == 2) return 999;
+    else return 600;
+}
+
+int main() {
+    int i;
+    for (i = -2; i < 9; i++) { putint(dense(i)); putchar(32); }
+    putchar(10);
+    putint(sparse(-1000)); putint(sparse(7)); putint(sparse(100000)); putint(sparse(2147483647)); putint(sparse(3));
+    putchar(32); putint(calls); putchar(10);
+    for (i = 0; i < 4; i++) { putint(tiny(i)); putchar(32); }
+    putchar(10);
+    putint(chars('a')); putint(chars('b')); putint(chars('u')); putint(chars('o')); putchar(10);
+    putint(machine(50)); putchar(10);
+    for (i = -1; i < 7; i++) { putint(chain(i)); putchar(32); }
+    putchar(10);
+    switch (3) { case 3: putint(33); break; default: putint(44); }
+    switch (2) { }
+    putchar(10);
+    return 0;
+}